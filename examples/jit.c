@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Dfa.h"
+
+
+#define LEN_STATES_MAX 300
+#define LEN_INPUT 200
+
+
+// Adds the same random transitions to both Dfas. Some states get more than
+// 255 rows apart so wider state indices are covered.
+void add_random_transitions(Dfa *table_ptr, Dfa *jit_ptr, int len_states){
+	for (int i = 0; i < len_states; ++i){
+		int len_transitions = rand()%4;
+		for (int k = 0; k < len_transitions; ++k){
+			int to_state = rand()%len_states;
+			char symbol = 'a' + rand()%4;
+
+			switch(rand()%3){
+				case 0:
+					Dfa_add_transition_single(table_ptr, i, to_state, symbol);
+					Dfa_add_transition_single(jit_ptr, i, to_state, symbol);
+					break;
+				case 1:
+					Dfa_add_transition_range(table_ptr, i, to_state, symbol, symbol + 2);
+					Dfa_add_transition_range(jit_ptr, i, to_state, symbol, symbol + 2);
+					break;
+				default:
+					Dfa_add_transition_single_invert(table_ptr, i, to_state, symbol);
+					Dfa_add_transition_single_invert(jit_ptr, i, to_state, symbol);
+					break;
+			}
+		}
+	}
+}
+
+// Returns 1 if both Dfas are in the same state with the same counter
+int same_configuration(Dfa *table_ptr, Dfa *jit_ptr){
+	int state_table, state_jit;
+	int64_t counter_table, counter_jit;
+
+	Dfa_get_current_configuration_64(table_ptr, &state_table, NULL, &counter_table);
+	Dfa_get_current_configuration_64(jit_ptr, &state_jit, NULL, &counter_jit);
+
+	return state_table == state_jit && counter_table == counter_jit;
+}
+
+// Runs input through both Dfas in chunks, retracting after each trap, and
+// compares every return code, state and counter
+int check_run(Dfa *table_ptr, Dfa *jit_ptr, char *input, int len_input){
+	int start = 0;
+	while(start < len_input){
+		Dfa_reset(table_ptr);
+		Dfa_reset(jit_ptr);
+
+		int len_chunk = 1 + rand()%16;
+		int status_table = DFA_RUN_RESULT_MORE_INPUT;
+		int status_jit = DFA_RUN_RESULT_MORE_INPUT;
+
+		for (int i = start; i < len_input && status_table == DFA_RUN_RESULT_MORE_INPUT; i += len_chunk){
+			int len = len_input - i < len_chunk ? len_input - i : len_chunk;
+			status_table = Dfa_run(table_ptr, input + i, len, i + 1);
+			status_jit = Dfa_run(jit_ptr, input + i, len, i + 1);
+
+			if(status_table != status_jit || !same_configuration(table_ptr, jit_ptr)){
+				printf("run from %d: table %d jit %d\n", start, status_table, status_jit);
+				return 0;
+			}
+		}
+
+		status_table = Dfa_retract(table_ptr);
+		status_jit = Dfa_retract(jit_ptr);
+		if(status_table != status_jit || !same_configuration(table_ptr, jit_ptr)){
+			printf("retract from %d: table %d jit %d\n", start, status_table, status_jit);
+			return 0;
+		}
+
+		// Continue after the match, or after the first symbol if none
+		int64_t counter;
+		Dfa_get_current_configuration_64(table_ptr, NULL, NULL, &counter);
+		start = (status_table == DFA_RETRACT_RESULT_SUCCESS && counter > start) ? counter : start + 1;
+	}
+
+	return 1;
+}
+
+
+int main(int argc, char const *argv[])
+{
+	int len_trials = argc > 1 ? atoi(argv[1]) : 200;
+	int len_failed = 0;
+
+	srand(1);
+
+	for (int t = 0; t < len_trials; ++t){
+		int len_states = t%10 == 0 ? LEN_STATES_MAX : 2 + rand()%8;
+
+		int states[LEN_STATES_MAX];
+		int final_states[LEN_STATES_MAX];
+		int len_final_states = 0;
+		for (int i = 0; i < len_states; ++i){
+			states[i] = i;
+			if(i > 0 && rand()%3 == 0){
+				final_states[len_final_states++] = i;
+			}
+		}
+
+		Dfa *table_ptr = Dfa_new(states, len_states, NULL, 0, 0, final_states, len_final_states);
+		Dfa *jit_ptr = Dfa_new(states, len_states, NULL, 0, 0, final_states, len_final_states);
+		add_random_transitions(table_ptr, jit_ptr, len_states);
+
+		Dfa_compile(table_ptr);
+		int status = Dfa_jit(jit_ptr);
+		if(status == DFA_JIT_RESULT_UNSUPPORTED){
+			printf("jit not supported on this platform\n");
+			Dfa_destroy(table_ptr);
+			Dfa_destroy(jit_ptr);
+			return 0;
+		}
+		if(status != DFA_JIT_RESULT_SUCCESS){
+			printf("trial %d: Dfa_jit failed\n", t);
+			len_failed++;
+		}
+
+		char input[LEN_INPUT];
+		for (int i = 0; i < LEN_INPUT; ++i){
+			// Mostly symbols with transitions, some without
+			input[i] = rand()%8 ? 'a' + rand()%6 : rand()%256;
+		}
+
+		if(status == DFA_JIT_RESULT_SUCCESS && !check_run(table_ptr, jit_ptr, input, LEN_INPUT)){
+			printf("trial %d: states:%d mismatch\n", t, len_states);
+			len_failed++;
+		}
+
+		Dfa_destroy(table_ptr);
+		Dfa_destroy(jit_ptr);
+	}
+
+	printf("trials:%d failed:%d\t%s\n", len_trials, len_failed, len_failed ? "FAIL" : "ok");
+
+	return len_failed ? 1 : 0;
+}
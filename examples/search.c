@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Dfa.h"
+
+
+typedef struct Matches{
+	int64_t starts[16];
+	int64_t ends[16];
+	int len_matches;
+} Matches;
+
+void match_function(int64_t start, int64_t end, void *data){
+	Matches *matches_ptr = data;
+	if(matches_ptr->len_matches < 16){
+		matches_ptr->starts[matches_ptr->len_matches] = start;
+		matches_ptr->ends[matches_ptr->len_matches] = end;
+	}
+	matches_ptr->len_matches++;
+}
+
+// Searches input in chunks of len_chunk, and compares with expected spans
+int check_search(Dfa *dfa_ptr, DFA_SearchMode_type mode, char *input, int len_chunk, int64_t *expected, int len_expected){
+	Matches matches = {{0}, {0}, 0};
+	int len_input = strlen(input);
+
+	DfaSearch *search_ptr = DfaSearch_new(dfa_ptr, mode);
+	for (int i = 0; i < len_input; i += len_chunk){
+		int len = len_input - i < len_chunk ? len_input - i : len_chunk;
+		Dfa_search(search_ptr, input + i, len, match_function, &matches);
+	}
+	Dfa_search_finish(search_ptr, match_function, &matches);
+	DfaSearch_destroy(search_ptr);
+
+	printf("in:%s\tchunk:%d\tmatches:", input, len_chunk);
+	int ok = (matches.len_matches == len_expected);
+	for (int i = 0; i < matches.len_matches && i < 16; ++i){
+		printf(" [%ld,%ld]", (long)matches.starts[i], (long)matches.ends[i]);
+		if(ok && (matches.starts[i] != expected[2*i] || matches.ends[i] != expected[2*i + 1])){
+			ok = 0;
+		}
+	}
+	printf("\t%s\n", ok ? "ok" : "FAIL");
+
+	return ok;
+}
+
+
+int main(int argc, char const *argv[])
+{
+	int ok = 1;
+
+	// A younger attempt with a match meets an older attempt without one in
+	// the same state. The younger match must still be reported.
+	{
+		int states[] = {0,1,2,3,4,5};
+		int final_states[] = {3,5};
+
+		Dfa *dfa_ptr = Dfa_new(states, 6, NULL, 0, 0, final_states, 2);
+		Dfa_add_transition_single(dfa_ptr, 0, 1, 'a');
+		Dfa_add_transition_single(dfa_ptr, 0, 3, 'b');
+		Dfa_add_transition_single(dfa_ptr, 1, 2, 'b');
+		Dfa_add_transition_single(dfa_ptr, 3, 4, 'c');
+		Dfa_add_transition_single(dfa_ptr, 2, 4, 'c');
+		Dfa_add_transition_single(dfa_ptr, 4, 5, 'd');
+
+		int64_t expected[] = {2,2};
+		ok &= check_search(dfa_ptr, DFA_SEARCH_LEFTMOST_LONGEST, "abcx", 4, expected, 1);
+		ok &= check_search(dfa_ptr, DFA_SEARCH_LEFTMOST_LONGEST, "abcx", 1, expected, 1);
+
+		Dfa_destroy(dfa_ptr);
+	}
+
+	// A match held back by an older attempt must survive when the older
+	// attempt's match, which ends before it, is finished at end of stream
+	{
+		int states[] = {0,1,2,3,4,5};
+		int final_states[] = {5};
+
+		Dfa *dfa_ptr = Dfa_new(states, 6, NULL, 0, 0, final_states, 1);
+		Dfa_add_transition_single(dfa_ptr, 0, 4, 'b');
+		Dfa_add_transition_single(dfa_ptr, 0, 5, 'c');
+		Dfa_add_transition_single(dfa_ptr, 4, 5, 'd');
+		Dfa_add_transition_single(dfa_ptr, 5, 1, 'c');
+		Dfa_add_transition_single(dfa_ptr, 1, 2, 'd');
+
+		int64_t expected[] = {2,3, 4,4};
+		ok &= check_search(dfa_ptr, DFA_SEARCH_LEFTMOST_LONGEST, "dbdcd", 5, expected, 2);
+		ok &= check_search(dfa_ptr, DFA_SEARCH_LEFTMOST_LONGEST, "dbdcd", 1, expected, 2);
+
+		Dfa_destroy(dfa_ptr);
+	}
+
+	// Prefilter hits only count matches starting at a candidate, so the hit
+	// rate stays at or below 1. L = {ax, b}
+	{
+		int states[] = {0,1,2};
+		int final_states[] = {2};
+
+		Dfa *dfa_ptr = Dfa_new(states, 3, NULL, 0, 0, final_states, 1);
+		Dfa_add_transition_single(dfa_ptr, 0, 1, 'a');
+		Dfa_add_transition_single(dfa_ptr, 1, 2, 'x');
+		Dfa_add_transition_single(dfa_ptr, 0, 2, 'b');
+
+		int64_t expected[] = {2,2, 3,3, 4,4, 5,5, 6,6, 7,7, 8,8, 9,9, 10,10};
+		ok &= check_search(dfa_ptr, DFA_SEARCH_LEFTMOST_LONGEST, "abbbbbbbbb", 10, expected, 9);
+
+		uint64_t candidates, hits;
+		Dfa_get_prefilter_info(dfa_ptr, NULL, NULL, &candidates, &hits);
+		printf("prefilter candidates:%lu hits:%lu\t%s\n", (unsigned long)candidates, (unsigned long)hits, hits <= candidates ? "ok" : "FAIL");
+		ok &= (hits <= candidates);
+
+		Dfa_destroy(dfa_ptr);
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "DfaSwap.h"
+
+
+#define LEN_READERS 4
+#define LEN_PUBLISHES 2000
+
+
+typedef struct ReaderArgs{
+	DfaSwap *swap_ptr;
+	DfaSwapReader *reader_ptr;
+	atomic_int *done_ptr;
+	long len_reads;
+	long len_failed;
+} ReaderArgs;
+
+// Version v matches the single symbol 'a' if v is odd, else 'b', so readers
+// can tell whether the view they got belongs to the version they pinned
+Dfa *dfa_for_version(uint64_t version){
+	// Dfa_new keeps the arrays, so they must outlive every version
+	static int states[] = {0,1};
+	static int final_states[] = {1};
+
+	Dfa *dfa_ptr = Dfa_new(states, 2, NULL, 0, 0, final_states, 1);
+	Dfa_add_transition_single(dfa_ptr, 0, 1, version%2 ? 'a' : 'b');
+
+	// Readers share the tables, so build them before publishing
+	Dfa_compile(dfa_ptr);
+	Dfa_compile_reverse(dfa_ptr);
+
+	return dfa_ptr;
+}
+
+void *reader_function(void *data){
+	ReaderArgs *args_ptr = data;
+	char input[] = {'a', 'b'};
+
+	while(!atomic_load(args_ptr->done_ptr)){
+		uint64_t version;
+		Dfa *view_ptr = DfaSwapReader_enter(args_ptr->reader_ptr, &version);
+
+		size_t start;
+		int status = Dfa_find(view_ptr, input, 2, &start, NULL);
+		if(status != DFA_FIND_RESULT_FOUND || start != (version%2 ? 0 : 1)){
+			args_ptr->len_failed++;
+		}
+
+		DfaSwapReader_exit(args_ptr->reader_ptr);
+		args_ptr->len_reads++;
+	}
+
+	return NULL;
+}
+
+
+int main(int argc, char const *argv[])
+{
+	DfaSwap *swap_ptr = DfaSwap_new(dfa_for_version(1));
+	atomic_int done = 0;
+
+	pthread_t threads[LEN_READERS];
+	ReaderArgs args[LEN_READERS];
+	for (int i = 0; i < LEN_READERS; ++i){
+		args[i] = (ReaderArgs){swap_ptr, DfaSwapReader_new(swap_ptr), &done, 0, 0};
+		pthread_create(&threads[i], NULL, reader_function, &args[i]);
+	}
+
+	// Versions are numbered in publish order, and this is the only writer
+	int ok = 1;
+	for (uint64_t version = 2; version < LEN_PUBLISHES + 2; ++version){
+		if(DfaSwap_publish(swap_ptr, dfa_for_version(version)) != version){
+			ok = 0;
+		}
+	}
+
+	atomic_store(&done, 1);
+
+	long len_reads = 0;
+	long len_failed = 0;
+	for (int i = 0; i < LEN_READERS; ++i){
+		pthread_join(threads[i], NULL);
+		DfaSwapReader_destroy(args[i].reader_ptr);
+		len_reads += args[i].len_reads;
+		len_failed += args[i].len_failed;
+	}
+
+	// No reader is left to pin a retired version
+	int len_retired = DfaSwap_reclaim(swap_ptr);
+	DfaSwap_destroy(swap_ptr);
+
+	ok = ok && len_failed == 0 && len_retired == 0;
+	printf("readers:%d publishes:%d reads:%ld failed:%ld retired:%d\t%s\n", LEN_READERS, LEN_PUBLISHES, len_reads, len_failed, len_retired, ok ? "ok" : "FAIL");
+
+	return ok ? 0 : 1;
+}
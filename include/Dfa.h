@@ -5,6 +5,9 @@
 #ifndef INCLUDE_GUARD_17F57653EFD148E09EA7E032CB25872E
 #define INCLUDE_GUARD_17F57653EFD148E09EA7E032CB25872E
 
+#include <stddef.h>
+#include <stdint.h>
+
 ///////////////
 // Constants //
 ///////////////
@@ -12,6 +15,11 @@
 static const int DFA_STATE_CLASS_NONFINAL = 0;
 static const int DFA_STATE_CLASS_FINAL = 1;
 
+// Flags for Dfa_set_memory_policy
+static const int DFA_MEMORY_HUGE_PAGES_TRANSPARENT = 1;
+static const int DFA_MEMORY_HUGE_PAGES_EXPLICIT = 2;
+static const int DFA_MEMORY_NUMA_REPLICATE = 4;
+
 
 ///////////
 // Types //
@@ -36,6 +44,48 @@ typedef enum{
 	DFA_RETRACT_RESULT_FAIL = -1
 }DFA_RetractResult_type;
 
+typedef enum{
+	DFA_COMPILE_RESULT_SUCCESS,
+	DFA_COMPILE_RESULT_FAIL = -1
+}DFA_CompileResult_type;
+
+typedef enum{
+	DFA_JIT_RESULT_SUCCESS,
+	DFA_JIT_RESULT_UNSUPPORTED,
+	DFA_JIT_RESULT_FAIL = -1
+}DFA_JitResult_type;
+
+typedef enum{
+	DFA_FIND_RESULT_FOUND,
+	DFA_FIND_RESULT_NOT_FOUND,
+	DFA_FIND_RESULT_FAIL = -1
+}DFA_FindResult_type;
+
+typedef enum{
+	DFA_PREFILTER_NONE,
+	DFA_PREFILTER_BYTES,
+	DFA_PREFILTER_LITERAL
+}DFA_Prefilter_type;
+
+typedef enum{
+	DFA_HUGE_PAGES_NONE,
+	DFA_HUGE_PAGES_TRANSPARENT,
+	DFA_HUGE_PAGES_EXPLICIT
+}DFA_HugePages_type;
+
+typedef enum{
+	DFA_SEARCH_LEFTMOST_LONGEST,
+	DFA_SEARCH_LEFTMOST_FIRST
+}DFA_SearchMode_type;
+
+/**
+ * Called by Dfa_search for each match, in order
+ * @param start Global index of first symbol of the match
+ * @param end   Global index of last symbol of the match
+ * @param data  Pointer passed to Dfa_search
+ */
+typedef void (*DfaSearch_MatchFunction_type)(int64_t start, int64_t end, void *data);
+
 
 /////////////////////
 // Data Structures //
@@ -46,6 +96,40 @@ typedef enum{
  */
 typedef struct Dfa Dfa;
 
+/**
+ * Opaque struct to hold the state of an unanchored search over a stream
+ */
+typedef struct DfaSearch DfaSearch;
+
+/**
+ * Structure and memory statistics of a Dfa, filled by Dfa_get_stats
+ */
+typedef struct DfaStats{
+	int len_states;
+
+	// Number of transitions, in total and by how they were added
+	int len_transitions;
+	int len_transitions_single;
+	int len_transitions_single_invert;
+	int len_transitions_many;
+	int len_transitions_many_invert;
+	int len_transitions_range;
+	int len_transitions_custom;
+	int len_transitions_regex;
+
+	// Longest chain of transitions tested by Dfa_step from one state, when
+	// not compiled, and that state's identifier
+	int len_chain_max;
+	int state_chain_max;
+
+	size_t transition_bytes;	// Transition nodes, including inline regex_t
+	size_t symbol_bytes;	// Symbol arrays of many and many invert transitions
+	size_t regex_bytes;	// Pattern buffers of regex transitions, a lower bound
+	size_t hash_table_bytes_estimate;	// State class and transition tables, estimated
+	size_t compiled_bytes;	// Compiled table, replicas, native code and reverse Dfa
+	size_t total_bytes;	// All of the above, and the Dfa struct
+} DfaStats;
+
 //////////////////////////////////
 // Constructors and Destructors //
 //////////////////////////////////
@@ -63,6 +147,18 @@ typedef struct Dfa Dfa;
  */
 Dfa *Dfa_new(int *states, int len_states, char *symbols, int len_symbols, int start_state, int *final_states, int len_final_states);
 
+/**
+ * Allocates a Dfa which shares the states, transitions and compiled table of
+ * @p dfa_ptr, but has its own state, counter and last final state. Views let
+ * several threads run the same automaton concurrently, one view per thread.
+ * Transitions cannot be added to, and Dfa_compile fails on, a view. The
+ * original Dfa must not be modified or destroyed while views of it exist.
+ * @param  dfa_ptr Pointer to the original Dfa struct
+ * @return         Pointer to allocated view, in start state with counter zero.
+ * Free with Dfa_destroy
+ */
+Dfa *Dfa_new_view(Dfa *dfa_ptr);
+
 /**
  * Deallocates all memory blocks associated with the Dfa struct
  * @param dfa_ptr pointer to the Dfa struct
@@ -173,6 +269,19 @@ DFA_StepResult_type Dfa_step(Dfa *dfa_ptr, char input_symbol);
  */
 DFA_RunResult_type Dfa_run(Dfa *dfa_ptr, char* input, int len_input, int global_index);
 
+/**
+ * Same as Dfa_run, with a size_t length and a 64 bit global index, for
+ * streams longer than INT_MAX symbols. The internal counter is always 64 bit,
+ * so Dfa_run and Dfa_run_64 may be mixed on the same Dfa.
+ * @param  dfa_ptr      Pointer to Dfa struct
+ * @param  input        Array of input symbols
+ * @param  len_input    Length of array
+ * @param  global_index Global index of the first symbol in the input array.
+ * Global index is one based (starts from 1)
+ * @return              Status, same as Dfa_run
+ */
+DFA_RunResult_type Dfa_run_64(Dfa *dfa_ptr, char* input, size_t len_input, int64_t global_index);
+
 /**
  * Skip a character. This function can be called in case step fails, or run
  * traps. This function increases the count of internal counter by one, which
@@ -215,10 +324,271 @@ void Dfa_reset(Dfa *dfa_ptr);
  *                        type. 0 for start. 1 for non start, non final. 2 for
  *                        final. Set to NULL to skip.
  * @param  counter_ptr    Pointer to location which will be assigned the value
- *                        of counter. Set to NULL to skip.
+ *                        of counter, truncated to int. Use
+ *                        Dfa_get_current_configuration_64 for long streams.
+ *                        Set to NULL to skip.
  */
 void Dfa_get_current_configuration(Dfa *dfa_ptr, int *state_ptr, int *state_type_ptr, int *counter_ptr);
 
+/**
+ * Same as Dfa_get_current_configuration, with a 64 bit counter
+ * @param  dfa_ptr        Pointer to Dfa struct
+ * @param  state_ptr      Pointer to location which will be assigned the state
+ *                        identifier. Set to NULL to skip.
+ * @param  state_type_ptr Pointer to location which will be assigned the state
+ *                        type. Set to NULL to skip.
+ * @param  counter_ptr    Pointer to location which will be assigned the value
+ *                        of counter. Set to NULL to skip.
+ */
+void Dfa_get_current_configuration_64(Dfa *dfa_ptr, int *state_ptr, int *state_type_ptr, int64_t *counter_ptr);
+
+/////////////////
+// Compile DFA //
+/////////////////
+
+/**
+ * Compiles all transitions into a dense table with one row of 256 entries per
+ * state. Each entry is stored in the narrowest unsigned type (1, 2 or 4 bytes)
+ * which can index every state, so small and medium Dfas fit in L1 cache.
+ * Once compiled, Dfa_step and Dfa_run use the table instead of testing the
+ * transitions. Custom and regex transitions are evaluated once per symbol at
+ * compile time, so they must not depend on anything but the symbol. Adding a
+ * transition discards the table; call this function again afterwards.
+ * @param  dfa_ptr Pointer to Dfa struct
+ * @return         Status
+ * @retval DFA_COMPILE_RESULT_SUCCESS Table built
+ * @retval DFA_COMPILE_RESULT_FAIL    A transition or the start state refers
+ * to a state not in the state list. The previous table, if any, is kept
+ */
+DFA_CompileResult_type Dfa_compile(Dfa *dfa_ptr);
+
+/**
+ * Get information about the compiled table
+ * @param dfa_ptr         Pointer to Dfa struct
+ * @param compiled_ptr    Pointer to location which will be assigned 1 if a
+ *                        compiled table is in use, else 0. Set to NULL to skip.
+ * @param state_width_ptr Pointer to location which will be assigned the bytes
+ *                        per state index, 1, 2 or 4. 0 if not compiled. Set to
+ *                        NULL to skip.
+ * @param table_bytes_ptr Pointer to location which will be assigned the size
+ *                        of the table in bytes. 0 if not compiled. Set to NULL
+ *                        to skip.
+ */
+void Dfa_get_compiled_info(Dfa *dfa_ptr, int *compiled_ptr, int *state_width_ptr, size_t *table_bytes_ptr);
+
+/**
+ * Sets how Dfa_compile allocates the compiled table. Takes effect on the next
+ * call to Dfa_compile. Only supported on Linux; elsewhere, and whenever a
+ * request cannot be met, the table is allocated with malloc.
+ * @param dfa_ptr      Pointer to Dfa struct
+ * @param memory_flags Zero, or any of
+ * DFA_MEMORY_HUGE_PAGES_TRANSPARENT to advise the kernel to back the table
+ * with transparent huge pages,
+ * DFA_MEMORY_HUGE_PAGES_EXPLICIT to map the table from reserved huge pages,
+ * falling back to transparent huge pages,
+ * DFA_MEMORY_NUMA_REPLICATE to keep a read only copy of the table on each
+ * NUMA node. Dfa_step, Dfa_run, Dfa_run_64, Dfa_find and Dfa_search then
+ * read the copy on the node of the calling thread, chosen once per call.
+ * Native code from Dfa_jit and the reverse Dfa are not replicated. Nodes
+ * to which a copy could not be bound read the copy of the first node
+ * instead. Ignored on single node machines.
+ * Mapped tables are made read only once filled.
+ */
+void Dfa_set_memory_policy(Dfa *dfa_ptr, int memory_flags);
+
+/**
+ * Get information about where the compiled table is placed
+ * @param dfa_ptr          Pointer to Dfa struct
+ * @param huge_pages_ptr   Pointer to location which will be assigned the huge
+ *                         page backing. For replicas, the least backing among
+ *                         them. Set to NULL to skip.
+ * @param len_replicas_ptr Pointer to location which will be assigned the
+ *                         number of copies of the table. 0 if not compiled.
+ *                         Set to NULL to skip.
+ * @param node_ptr         Pointer to location which will be assigned the NUMA
+ *                         node of the copy the calling thread would use, or
+ *                         -1 if not replicated. Set to NULL to skip.
+ * @param bytes_ptr        Pointer to location which will be assigned the total
+ *                         bytes of all copies, including rounding up to
+ *                         pages. Set to NULL to skip.
+ */
+void Dfa_get_memory_placement(Dfa *dfa_ptr, DFA_HugePages_type *huge_pages_ptr, int *len_replicas_ptr, int *node_ptr, size_t *bytes_ptr);
+
+/**
+ * Generates native code from the compiled table, and uses it in Dfa_run and
+ * Dfa_run_64. Each state becomes a block of code which compares the symbol
+ * against runs of symbols sharing a target, and jumps to the target's block.
+ * Return codes, state, counter and Dfa_retract behave exactly as with the
+ * table. Compiles the Dfa if needed. The code is discarded along with the
+ * table when a transition is added. Only available on x86-64 Linux; on other
+ * platforms the table is used.
+ * @param  dfa_ptr Pointer to Dfa struct
+ * @return         Status
+ * @retval DFA_JIT_RESULT_SUCCESS     Native code in use
+ * @retval DFA_JIT_RESULT_UNSUPPORTED Platform not supported, table in use
+ * @retval DFA_JIT_RESULT_FAIL        Dfa could not be compiled, @p dfa_ptr is
+ * a view, the code would exceed 64 MiB, or an executable mapping could not be
+ * created. Table in use if compiled
+ */
+DFA_JitResult_type Dfa_jit(Dfa *dfa_ptr);
+
+/**
+ * Get information about the native code generated by Dfa_jit
+ * @param dfa_ptr        Pointer to Dfa struct
+ * @param jit_ptr        Pointer to location which will be assigned 1 if native
+ *                       code is in use, else 0. Set to NULL to skip.
+ * @param code_bytes_ptr Pointer to location which will be assigned the size
+ *                       of the executable mapping in bytes. Set to NULL to
+ *                       skip.
+ */
+void Dfa_get_jit_info(Dfa *dfa_ptr, int *jit_ptr, size_t *code_bytes_ptr);
+
+////////////
+// Search //
+////////////
+
+/**
+ * Finds the leftmost longest non empty match in @p input in three linear
+ * passes: the pass of Dfa_search finds where the leftmost match first ends,
+ * Dfa_find_start finds its start from there, and an anchored run from the
+ * start finds its longest end. The cost is O(n*S) for n symbols and S Dfa
+ * states in the worst case, without restarting at every offset. The state
+ * and counter of the Dfa are not changed. Compiles the Dfa, and builds the
+ * reverse Dfa, if needed. On a view without a reverse Dfa the start from the
+ * first pass is used.
+ * If Dfa_compile found a prefilter, offsets which cannot start a match are
+ * skipped with a vectorized scan for the required leading symbols.
+ * @param  dfa_ptr       Pointer to Dfa struct
+ * @param  input         Array of input symbols
+ * @param  len_input     Length of array
+ * @param  start_ptr     Pointer to location which will be assigned the zero
+ *                       based offset of the match. Set to NULL to skip.
+ * @param  len_match_ptr Pointer to location which will be assigned the length
+ *                       of the match. Set to NULL to skip.
+ * @return               Status
+ * @retval DFA_FIND_RESULT_FOUND     Match found
+ * @retval DFA_FIND_RESULT_NOT_FOUND No match in @p input
+ * @retval DFA_FIND_RESULT_FAIL      Dfa could not be compiled
+ */
+DFA_FindResult_type Dfa_find(Dfa *dfa_ptr, char *input, size_t len_input, size_t *start_ptr, size_t *len_match_ptr);
+
+/**
+ * Get information about the prefilter found by Dfa_compile, and how well it
+ * performed in searches on this Dfa
+ * @param dfa_ptr            Pointer to Dfa struct
+ * @param prefilter_type_ptr Pointer to location which will be assigned
+ *                           DFA_PREFILTER_BYTES if every match starts with one
+ *                           of up to 3 symbols, DFA_PREFILTER_LITERAL if every
+ *                           match starts with a fixed string, else
+ *                           DFA_PREFILTER_NONE. Set to NULL to skip.
+ * @param len_prefilter_ptr  Pointer to location which will be assigned the
+ *                           number of symbols in the set or string. Set to
+ *                           NULL to skip.
+ * @param candidates_ptr     Pointer to location which will be assigned the
+ *                           number of candidate offsets the prefilter found.
+ *                           Set to NULL to skip.
+ * @param hits_ptr           Pointer to location which will be assigned the
+ *                           number of candidates which started a match. Hit
+ *                           rate is hits/candidates. Set to NULL to skip.
+ */
+void Dfa_get_prefilter_info(Dfa *dfa_ptr, DFA_Prefilter_type *prefilter_type_ptr, int *len_prefilter_ptr, uint64_t *candidates_ptr, uint64_t *hits_ptr);
+
+/**
+ * Builds a Dfa for the reversed strings from the compiled table, by reversing
+ * every transition and determinizing. Its start state is the set of final
+ * states, and its final states are the sets holding the start state. Compiles
+ * the Dfa if needed. The reverse Dfa is discarded with the compiled table.
+ * The number of reverse states can grow exponentially in the worst case.
+ * @param  dfa_ptr Pointer to Dfa struct
+ * @return         Status
+ * @retval DFA_COMPILE_RESULT_SUCCESS Reverse Dfa built
+ * @retval DFA_COMPILE_RESULT_FAIL    Dfa could not be compiled, @p dfa_ptr is
+ * a view of a Dfa without a reverse Dfa, or the reverse Dfa would exceed
+ * 2^20 states
+ */
+DFA_CompileResult_type Dfa_compile_reverse(Dfa *dfa_ptr);
+
+/**
+ * Finds where a match which ends at @p end starts, by running the reverse Dfa
+ * backward from @p end once. Use it after a forward scan, for example
+ * Dfa_run followed by Dfa_retract, reports the end of a match. Builds the
+ * reverse Dfa if needed. The state and counter of the Dfa are not changed.
+ * The scan stops at @p begin, so a start is never placed before the offset
+ * the forward scan started at, for example the end of the previous match.
+ * @param  dfa_ptr   Pointer to Dfa struct
+ * @param  input     Array of input symbols
+ * @param  begin     Zero based offset of the first symbol a match may start
+ *                   at. Set to 0 to allow any start.
+ * @param  end       Zero based offset one past the last symbol of the match
+ * @param  start_ptr Pointer to location which will be assigned the zero based
+ *                   offset of the leftmost start, not before @p begin, of a
+ *                   non empty match ending at @p end. Set to NULL to skip.
+ * @return           Status
+ * @retval DFA_FIND_RESULT_FOUND     Start found
+ * @retval DFA_FIND_RESULT_NOT_FOUND No non empty match starting at or after
+ * @p begin ends at @p end
+ * @retval DFA_FIND_RESULT_FAIL      Reverse Dfa could not be built
+ */
+DFA_FindResult_type Dfa_find_start(Dfa *dfa_ptr, char *input, size_t begin, size_t end, size_t *start_ptr);
+
+/**
+ * Allocates an unanchored search over a stream, which may be fed in chunks.
+ * Compiles the Dfa if needed. The search reads the compiled table of the
+ * Dfa, so the Dfa must not be changed while the search exists. The state and
+ * counter of the Dfa are not used.
+ * @param  dfa_ptr Pointer to Dfa struct
+ * @param  mode    DFA_SEARCH_LEFTMOST_LONGEST to end each match at the last
+ *                 final state reached from its start, or
+ *                 DFA_SEARCH_LEFTMOST_FIRST to end it at the first
+ * @return         Pointer to allocated DfaSearch struct, or NULL if the Dfa
+ *                 could not be compiled
+ */
+DfaSearch *DfaSearch_new(Dfa *dfa_ptr, DFA_SearchMode_type mode);
+
+/**
+ * Deallocates all memory blocks associated with the DfaSearch struct
+ * @param search_ptr Pointer to DfaSearch struct
+ */
+void DfaSearch_destroy(DfaSearch *search_ptr);
+
+/**
+ * Discards all running and unreported matches, and sets the counter to zero
+ * @param search_ptr Pointer to DfaSearch struct
+ */
+void DfaSearch_reset(DfaSearch *search_ptr);
+
+/**
+ * Feeds the next chunk of the stream. Reports all leftmost, non overlapping,
+ * non empty matches in a single pass, without rescanning any symbol. Every
+ * offset is tried as a match start in parallel, with at most one attempt per
+ * Dfa state. A match is reported once no attempt starting further left can
+ * still match, which may be in a later call.
+ * Each symbol advances every running attempt, so the cost is O(n*S) for n
+ * symbols and S Dfa states in the worst case, and O(n) when attempts die
+ * quickly. No unanchored automaton is built, as it would find match ends but
+ * not their starts, which are needed in order across chunk boundaries.
+ * If Dfa_compile found a prefilter, offsets which cannot start a match are
+ * skipped with a vectorized scan whenever no attempt is running.
+ * @param  search_ptr     Pointer to DfaSearch struct
+ * @param  input          Array of input symbols, following the previous chunk
+ * @param  len_input      Length of array
+ * @param  match_function Function called for every match. Set to NULL to only
+ *                        count matches.
+ * @param  data           Pointer passed to @p match_function
+ * @return                Number of matches reported in this call
+ */
+int Dfa_search(DfaSearch *search_ptr, char *input, size_t len_input, DfaSearch_MatchFunction_type match_function, void *data);
+
+/**
+ * Ends the stream, reports all remaining matches, and resets the search
+ * @param  search_ptr     Pointer to DfaSearch struct
+ * @param  match_function Function called for every match. Set to NULL to only
+ *                        count matches.
+ * @param  data           Pointer passed to @p match_function
+ * @return                Number of matches reported in this call
+ */
+int Dfa_search_finish(DfaSearch *search_ptr, DfaSearch_MatchFunction_type match_function, void *data);
+
 ///////////
 // Other //
 ///////////
@@ -242,4 +612,16 @@ void Dfa_get_state_lists(Dfa *dfa_ptr, int **states, int *len_states, int *start
  */
 void Dfa_get_symbol_list(Dfa *dfa_ptr, char **symbols, int *len_symbols);
 
+/**
+ * Get structure and memory statistics of the Dfa. For regex transitions only
+ * the pattern buffer and fastmap reported by glibc are counted, and nothing
+ * with other C libraries. The hash tables do not report their size, so it is
+ * estimated from their bucket and entry counts. The state and symbol arrays
+ * passed to Dfa_new are not counted. For a view, the shared parts of the
+ * original Dfa are counted.
+ * @param dfa_ptr   Pointer to Dfa struct
+ * @param stats_ptr Pointer to DfaStats struct which will be filled
+ */
+void Dfa_get_stats(Dfa *dfa_ptr, DfaStats *stats_ptr);
+
 #endif
@@ -0,0 +1,112 @@
+/**
+ *	This file exposes a versioned handle which lets a writer replace the Dfa
+ *	used by scanning threads without stopping them
+ */
+
+#ifndef INCLUDE_GUARD_5C0E8D2A41B94F7A9E63B1D07F2C84A6
+#define INCLUDE_GUARD_5C0E8D2A41B94F7A9E63B1D07F2C84A6
+
+#include <stdint.h>
+
+#include "Dfa.h"
+
+
+/////////////////////
+// Data Structures //
+/////////////////////
+
+/**
+ * Opaque struct holding the currently published Dfa and the Dfas retired by
+ * earlier publishes which may still be in use by readers
+ */
+typedef struct DfaSwap DfaSwap;
+
+/**
+ * Opaque struct holding the per thread state of a reader. Each scanning
+ * thread needs its own reader.
+ */
+typedef struct DfaSwapReader DfaSwapReader;
+
+//////////////////////////////////
+// Constructors and Destructors //
+//////////////////////////////////
+
+/**
+ * Allocates a handle and publishes @p dfa_ptr as version 1. The handle takes
+ * ownership of the Dfa.
+ * @param  dfa_ptr Pointer to the first Dfa to publish
+ * @return         Pointer to allocated DfaSwap struct
+ */
+DfaSwap *DfaSwap_new(Dfa *dfa_ptr);
+
+/**
+ * Destroys the published and all retired Dfas, and deallocates the handle.
+ * All readers must be destroyed first.
+ * @param swap_ptr Pointer to DfaSwap struct
+ */
+void DfaSwap_destroy(DfaSwap *swap_ptr);
+
+/**
+ * Allocates a reader and registers it with the handle
+ * @param  swap_ptr Pointer to DfaSwap struct
+ * @return          Pointer to allocated DfaSwapReader struct
+ */
+DfaSwapReader *DfaSwapReader_new(DfaSwap *swap_ptr);
+
+/**
+ * Unregisters and deallocates a reader. The reader must not be inside
+ * DfaSwapReader_enter and DfaSwapReader_exit.
+ * @param reader_ptr Pointer to DfaSwapReader struct
+ */
+void DfaSwapReader_destroy(DfaSwapReader *reader_ptr);
+
+/////////////
+// Writers //
+/////////////
+
+/**
+ * Atomically replaces the published Dfa with @p dfa_ptr. Readers which
+ * have entered keep using the previous Dfa until they exit. The previous Dfa
+ * is retired, and destroyed once no reader references it. Publishing is
+ * serialized between writers. The handle takes ownership of the Dfa, which
+ * should be compiled beforehand so readers share one table.
+ * @param  swap_ptr Pointer to DfaSwap struct
+ * @param  dfa_ptr  Pointer to the Dfa to publish
+ * @return          Version number of the published Dfa
+ */
+uint64_t DfaSwap_publish(DfaSwap *swap_ptr, Dfa *dfa_ptr);
+
+/**
+ * Destroys retired Dfas which are no longer referenced by any reader. This is
+ * also done on every publish.
+ * @param  swap_ptr Pointer to DfaSwap struct
+ * @return          Number of retired Dfas still waiting for readers to exit
+ */
+int DfaSwap_reclaim(DfaSwap *swap_ptr);
+
+/////////////
+// Readers //
+/////////////
+
+/**
+ * Pins the currently published Dfa and returns a view of it private to this
+ * reader. If the published version has not changed since the last call, the
+ * same view is returned with its state and counter intact, so a stream can
+ * be scanned across several enter and exit pairs. If it has changed, a fresh
+ * view of the new Dfa in start state is returned. Lock free; never waits for
+ * writers.
+ * @param  reader_ptr  Pointer to DfaSwapReader struct
+ * @param  version_ptr Pointer to location which will be assigned the version
+ *                     number of the pinned Dfa. Set to NULL to skip.
+ * @return             Pointer to view, valid until DfaSwapReader_exit
+ */
+Dfa *DfaSwapReader_enter(DfaSwapReader *reader_ptr, uint64_t *version_ptr);
+
+/**
+ * Unpins the Dfa pinned by DfaSwapReader_enter, allowing it to be destroyed
+ * if it has been retired
+ * @param reader_ptr Pointer to DfaSwapReader struct
+ */
+void DfaSwapReader_exit(DfaSwapReader *reader_ptr);
+
+#endif
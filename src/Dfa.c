@@ -1,8 +1,29 @@
+#if defined(__linux__)
+// For sched_getcpu
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <regex.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) && defined(__linux__)
+#define DFA_JIT_X86_64
+#endif
+
 #include "Dfa.h"
 #include "HashTable.h"
 
@@ -23,6 +44,35 @@ typedef enum {
 } TransitionClass_type;
 
 
+///////////////
+// Constants //
+///////////////
+
+// Longest literal prefix extracted for the prefilter
+#define PREFILTER_LEN_MAX 32
+
+// Largest set of start symbols scanned for by the prefilter
+#define PREFILTER_LEN_BYTES_MAX 3
+
+// Largest native code generated for one Dfa
+#define JIT_CODE_BYTES_MAX ((size_t)64 << 20)
+
+// Largest number of states in a reverse Dfa
+#define REVERSE_LEN_STATES_MAX (1 << 20)
+
+// Size of a huge page, used to round up mappings
+#define HUGE_PAGE_BYTES ((size_t)2 << 20)
+
+// NUMA nodes beyond this get no replica, and use the primary table
+#define NUMA_LEN_NODES_MAX 64
+
+// From linux/mempolicy.h
+#define NUMA_MPOL_BIND 2
+
+// Symbols fed to the search pass of Dfa_find between checks for a match
+#define FIND_LEN_BLOCK 4096
+
+
 /////////////////////
 // Data Structures //
 /////////////////////
@@ -56,7 +106,108 @@ typedef struct DfaTransition {
 	};
 } DfaTransition;
 
+// Passed to generated code. Offsets of the fields are hard coded in the
+// generated instructions.
+typedef struct DfaJitContext{
+	uint32_t state_index;	// In: start row. Out: row when stopped
+	uint32_t state_index_last_final;	// Out: row of last final state
+	const unsigned char *input_cur;	// Out: first symbol not consumed
+	const unsigned char *input_last_final;	// Out: symbol after last final state, NULL if none
+} DfaJitContext;
+
+// Returns 1 if trapped, 0 if input exhausted
+typedef int (*DfaJit_RunFunction_type)(const unsigned char *input, const unsigned char *input_end, DfaJitContext *ctx_ptr);
+
+typedef struct DfaJit{
+	void *code;
+	size_t code_bytes;
+	DfaJit_RunFunction_type run_function;
+} DfaJit;
+
+typedef struct DfaCompiled DfaCompiled;
+typedef struct DfaCompiled{
+	int state_width;	// Bytes per state index, 1, 2 or 4
+	int len_states;	// Number of rows, including the dead state
+	int start_index;
+	int dead_index;	// Row which traps on every symbol, always the last row
+
+	void *table;	// len_states rows of 256 next state indices
+	size_t table_bytes;
+
+	// Placement of table. If mapped, table_mapping_bytes is the size of each
+	// mapping, else 0 and table is from malloc. If replicated, table_replicas
+	// holds one copy per NUMA node, NULL for nodes without one, and table is
+	// one of them.
+	size_t table_mapping_bytes;
+	DFA_HugePages_type huge_pages;
+	void **table_replicas;
+	int len_table_replicas;
+	int *cpu_nodes;	// NUMA node of each CPU
+	int len_cpus;
+
+	unsigned char *final_flags;	// Non zero if row index is a final state
+
+	// Prefilter. For DFA_PREFILTER_BYTES every match starts with one of the
+	// symbols, for DFA_PREFILTER_LITERAL every match starts with the string.
+	DFA_Prefilter_type prefilter_type;
+	unsigned char prefilter_symbols[PREFILTER_LEN_MAX];
+	int len_prefilter_symbols;
+
+	// Native code generated from the table. NULL if not generated
+	DfaJit *jit;
+
+	// Dfa accepting the reversed strings, whose rows are sets of rows of this
+	// table. NULL if not built
+	DfaCompiled *reverse;
+} DfaCompiled;
+
+// Set of rows of a compiled table, used while building the reverse Dfa
+typedef struct DfaSubset{
+	int index;	// Row in reverse table
+	int len_words;
+	uint64_t *bits;
+} DfaSubset;
+
+typedef struct DfaSearchThread{
+	int index;	// Row index of current state
+	int64_t start;	// Global index of first symbol
+	int64_t end;	// Global index of last symbol of longest match, 0 if none
+	int is_candidate;	// Set if started at an offset found by the prefilter
+} DfaSearchThread;
+
+typedef struct DfaSearchMatch{
+	int64_t start;
+	int64_t end;
+	int is_candidate;
+} DfaSearchMatch;
+
+typedef struct DfaSearch{
+	Dfa *dfa_ptr;
+	DFA_SearchMode_type mode;
+
+	int64_t symbol_counter;	// Global index of symbol last read
+
+	// Running threads ordered by start, at most one per state. An older
+	// thread in the same state as a younger one always wins, so the younger
+	// one is dropped.
+	DfaSearchThread *threads;
+	DfaSearchThread *threads_next;
+	int len_threads;
+	uint64_t *state_marks;	// Per row, step in which a thread entered it
+	uint64_t mark;
+
+	// Finished matches ordered by start, which cannot be reported until no
+	// older thread is running
+	DfaSearchMatch *matches;
+	int len_matches;
+	int cap_matches;
+} DfaSearch;
+
 typedef struct Dfa{
+	// If set, the parameters, tables and compiled table are borrowed from
+	// another Dfa, and only the state handling fields are owned
+	int is_view;
+
 	// Parameters
 
 	int *states;
@@ -76,12 +227,27 @@ typedef struct Dfa{
 	// State handling
 	
 	int state_cur;
-	int symbol_counter;	// Global index of symbol last read. If 0, no symbols
+	int64_t symbol_counter;	// Global index of symbol last read. If 0, no symbols
 	// have been read yet
 
 	int state_last_final_valid;
 	int state_last_final;
-	int symbol_counter_last_final;
+	int64_t symbol_counter_last_final;
+
+	// Compiled table. NULL if not compiled, or invalidated by a new transition.
+	// Row index i corresponds to states[i]
+
+	DfaCompiled *compiled;
+	int state_index_cur;
+	int state_index_last_final;
+
+	// DFA_MEMORY_* flags used by Dfa_compile
+	int memory_flags;
+
+	// Prefilter statistics, counted by Dfa_find
+
+	uint64_t prefilter_candidates;
+	uint64_t prefilter_hits;
 } Dfa;
 
 
@@ -102,6 +268,61 @@ static void add_transition_to_table(Dfa *dfa_ptr, DfaTransition *tr_ptr);
 // Returns 1 if tests succeeds, else 0
 static int test_transition(DfaTransition *tr_ptr, char input_symbol);
 
+static DfaCompiled *DfaCompiled_new(int *next_indices, unsigned char *final_flags, int len_states, int start_index);
+
+static void DfaCompiled_destroy(DfaCompiled *cmp_ptr);
+
+// Returns row index of state, or -1 if it is not in the state list
+static int find_state_index(int *sorted_pairs, int len_states, int state);
+
+// Reads table, which is the table of cmp_ptr or one of its replicas
+static unsigned int compiled_get(DfaCompiled *cmp_ptr, const void *table, unsigned int index, unsigned char symbol);
+
+static void analyze_prefilter(DfaCompiled *cmp_ptr, int *next_indices);
+
+// Returns offset of first candidate match start in input, or len_input
+static size_t scan_prefilter(DfaCompiled *cmp_ptr, const unsigned char *input, size_t len_input);
+
+// Thread has a match and will not extend it. Adds it to the finished matches.
+static void search_finish_thread(DfaSearch *search_ptr, DfaSearchThread *thread_ptr);
+
+// Thread has a new or longer match. Drops younger threads and finished
+// matches overlapping it.
+static void search_drop_overlapping(DfaSearch *search_ptr, DfaSearchThread *thread_ptr);
+
+// Returns number of matches reported
+static int search_report(DfaSearch *search_ptr, DfaSearch_MatchFunction_type match_function, void *data);
+
+// Match function which keeps the first match in an int64_t[2] whose end is 0
+static void find_first_match(int64_t start, int64_t end, void *data);
+
+static void step_compiled(Dfa *dfa_ptr, int index_next, int64_t counter_next);
+
+static void DfaJit_destroy(DfaJit *jit_ptr);
+
+static DfaCompiled *build_reverse(DfaCompiled *cmp_ptr);
+
+static int subset_hash_function(void *key);
+
+static int subset_key_compare(void *key1, void *key2);
+
+// Returns the number of symbols consumed before trapping, or len_input
+static size_t run_jit(Dfa *dfa_ptr, unsigned char *input, size_t len_input);
+
+// Returns the number of symbols consumed before trapping, or len_input
+static size_t run_compiled_8(Dfa *dfa_ptr, const void *table_ptr, unsigned char *input, size_t len_input);
+static size_t run_compiled_16(Dfa *dfa_ptr, const void *table_ptr, unsigned char *input, size_t len_input);
+static size_t run_compiled_32(Dfa *dfa_ptr, const void *table_ptr, unsigned char *input, size_t len_input);
+
+// Moves the table to memory placed according to DFA_MEMORY_* flags
+static void place_table(DfaCompiled *cmp_ptr, int memory_flags);
+
+// Returns the replica of the table on the NUMA node of the calling thread
+static const void *table_local(DfaCompiled *cmp_ptr);
+
+// Returns bytes held by a compiled table, its replicas, code and reverse
+static size_t compiled_bytes(DfaCompiled *cmp_ptr);
+
 
 //////////////////////////////////
 // Constructors and Destructors //
@@ -151,6 +372,15 @@ Dfa *Dfa_new(int *states, int len_states, char *symbols, int len_symbols, int st
 
 	dfa_ptr->transition_table = HashTable_new(len_states, hash_function, key_compare);
 
+	dfa_ptr->compiled = NULL;
+
+	dfa_ptr->is_view = 0;
+
+	dfa_ptr->memory_flags = 0;
+
+	dfa_ptr->prefilter_candidates = 0;
+	dfa_ptr->prefilter_hits = 0;
+
 
 	// Init state
 
@@ -167,9 +397,43 @@ Dfa *Dfa_new(int *states, int len_states, char *symbols, int len_symbols, int st
 	else{
 		dfa_ptr->state_last_final_valid = 0;
 	}
+
+	return dfa_ptr;
+}
+
+Dfa *Dfa_new_view(Dfa *dfa_ptr){
+	Dfa *view_ptr = malloc( sizeof(Dfa) );
+
+	memcpy(view_ptr, dfa_ptr, sizeof(Dfa));
+	view_ptr->is_view = 1;
+
+	view_ptr->prefilter_candidates = 0;
+	view_ptr->prefilter_hits = 0;
+
+	// Init state
+
+	Dfa_reset(view_ptr);
+
+	// If start state is a final state...
+	if( *(int *)( HashTable_get(view_ptr->state_class_table, &view_ptr->start_state) ) == DFA_STATE_CLASS_FINAL ){
+		view_ptr->state_last_final_valid = 1;
+		view_ptr->state_last_final = view_ptr->start_state;
+		view_ptr->symbol_counter_last_final = view_ptr->symbol_counter;
+		if(view_ptr->compiled){
+			view_ptr->state_index_last_final = view_ptr->compiled->start_index;
+		}
+	}
+
+	return view_ptr;
 }
 
 void Dfa_destroy(Dfa *dfa_ptr){
+	if(dfa_ptr->is_view){
+		// Everything but the struct is owned by the original Dfa
+		free(dfa_ptr);
+		return;
+	}
+
 	// Free all transitions
 	for (int i = 0; i < dfa_ptr->len_states; ++i){
 		// Cycle through all from states
@@ -188,6 +452,11 @@ void Dfa_destroy(Dfa *dfa_ptr){
 	HashTable_destroy(dfa_ptr->transition_table);
 	HashTable_destroy(dfa_ptr->state_class_table);
 
+	// Free compiled table
+	if(dfa_ptr->compiled){
+		DfaCompiled_destroy(dfa_ptr->compiled);
+	}
+
 	// Free Dfa
 	free(dfa_ptr);
 }
@@ -318,11 +587,18 @@ static void add_transition_to_table(Dfa *dfa_ptr, DfaTransition *tr_ptr){
 		}
 	}
 
-	if(from_state_ptr == NULL){
-		// Unrecoverable condition
+	if(from_state_ptr == NULL || dfa_ptr->is_view){
+		// Unrecoverable condition, the transition is not added
+		DfaTransition_destroy(tr_ptr);
 		return;
 	}
 
+	// Compiled table no longer reflects the transitions
+	if(dfa_ptr->compiled){
+		DfaCompiled_destroy(dfa_ptr->compiled);
+		dfa_ptr->compiled = NULL;
+	}
+
 	// No transition from this state exist
 	if(table_tr_ptr == NULL){
 		tr_ptr->next = NULL;
@@ -406,6 +682,18 @@ static int test_transition(DfaTransition *tr_ptr, char input_symbol){
 
 DFA_StepResult_type Dfa_step(Dfa *dfa_ptr, char input_symbol){
 
+	if(dfa_ptr->compiled){
+		DfaCompiled *cmp_ptr = dfa_ptr->compiled;
+		int index_next = compiled_get(cmp_ptr, table_local(cmp_ptr), dfa_ptr->state_index_cur, (unsigned char)input_symbol);
+
+		if(index_next == cmp_ptr->dead_index){
+			return DFA_STEP_RESULT_FAIL;
+		}
+
+		step_compiled(dfa_ptr, index_next, dfa_ptr->symbol_counter + 1);
+		return DFA_STEP_RESULT_SUCCESS;
+	}
+
 	DfaTransition *tr_ptr = HashTable_get(dfa_ptr->transition_table, &dfa_ptr->state_cur);
 	while(1){
 		if(tr_ptr == NULL){
@@ -440,17 +728,48 @@ DFA_StepResult_type Dfa_step(Dfa *dfa_ptr, char input_symbol){
 }
 
 DFA_RunResult_type Dfa_run(Dfa *dfa_ptr, char* input, int len_input, int global_index){
+	if(len_input < 0){
+		return DFA_RUN_RESULT_WRONG_INDEX;
+	}
+
+	return Dfa_run_64(dfa_ptr, input, (size_t)len_input, global_index);
+}
+
+DFA_RunResult_type Dfa_run_64(Dfa *dfa_ptr, char* input, size_t len_input, int64_t global_index){
 
 	// global index starts from 1
 	// Get buffer index of first symbol in input whose global index is counter+1
-	int j = dfa_ptr->symbol_counter + 1 - global_index;
+	int64_t offset = dfa_ptr->symbol_counter + 1 - global_index;
 
-	if( j < 0 || j >= len_input ){
+	if( offset < 0 || (uint64_t)offset >= len_input ){
 		// Symbol expected does not exist in buffer
 		return DFA_RUN_RESULT_WRONG_INDEX;
 	}
 
-	for (int i = j; i < len_input; ++i){
+	size_t j = (size_t)offset;
+
+	if(dfa_ptr->compiled){
+		size_t len_run = len_input - j;
+		size_t len_consumed;
+
+		if(dfa_ptr->compiled->jit){
+			len_consumed = run_jit(dfa_ptr, (unsigned char *)input + j, len_run);
+		}
+		else if(dfa_ptr->compiled->state_width == 1){
+			len_consumed = run_compiled_8(dfa_ptr, table_local(dfa_ptr->compiled), (unsigned char *)input + j, len_run);
+		}
+		else if(dfa_ptr->compiled->state_width == 2){
+			len_consumed = run_compiled_16(dfa_ptr, table_local(dfa_ptr->compiled), (unsigned char *)input + j, len_run);
+		}
+		else{
+			len_consumed = run_compiled_32(dfa_ptr, table_local(dfa_ptr->compiled), (unsigned char *)input + j, len_run);
+		}
+
+		if(len_consumed < len_run)	return DFA_RUN_RESULT_TRAP;
+		return DFA_RUN_RESULT_MORE_INPUT;
+	}
+
+	for (size_t i = j; i < len_input; ++i){
 		int status = Dfa_step(dfa_ptr, input[i]);
 
 		if(status == DFA_STEP_RESULT_SUCCESS)	continue;
@@ -470,6 +789,7 @@ DFA_RetractResult_type Dfa_retract(Dfa *dfa_ptr){
 	}
 
 	dfa_ptr->state_cur = dfa_ptr->state_last_final;
+	dfa_ptr->state_index_cur = dfa_ptr->state_index_last_final;
 	dfa_ptr->symbol_counter = dfa_ptr->symbol_counter_last_final;
 	// Invalidate last final state, as it is now used
 	dfa_ptr->state_last_final_valid = 0;
@@ -480,11 +800,20 @@ DFA_RetractResult_type Dfa_retract(Dfa *dfa_ptr){
 void Dfa_reset_state(Dfa *dfa_ptr){
 	dfa_ptr->state_cur = dfa_ptr->start_state;
 	dfa_ptr->state_last_final_valid = 0;
+
+	if(dfa_ptr->compiled){
+		dfa_ptr->state_index_cur = dfa_ptr->compiled->start_index;
+	}
 }
 
 void Dfa_reset(Dfa *dfa_ptr){
 	dfa_ptr->state_cur = dfa_ptr->start_state;
 	dfa_ptr->state_last_final_valid = 0;
+
+	if(dfa_ptr->compiled){
+		dfa_ptr->state_index_cur = dfa_ptr->compiled->start_index;
+	}
+
 	dfa_ptr->symbol_counter = 0;
 }
 
@@ -497,44 +826,1630 @@ void Dfa_get_current_configuration(Dfa *dfa_ptr, int *state_ptr, int *state_type
 		*state_type_ptr = *(int *)( HashTable_get(dfa_ptr->state_class_table, &(dfa_ptr->state_cur)) );
 	}
 
+	if(counter_ptr){
+		*counter_ptr = (int)dfa_ptr->symbol_counter;
+	}
+}
+
+void Dfa_get_current_configuration_64(Dfa *dfa_ptr, int *state_ptr, int *state_type_ptr, int64_t *counter_ptr){
+	Dfa_get_current_configuration(dfa_ptr, state_ptr, state_type_ptr, NULL);
+
 	if(counter_ptr){
 		*counter_ptr = dfa_ptr->symbol_counter;
 	}
 }
 
 
-///////////
-// Other //
-///////////
+/////////////////
+// Compile DFA //
+/////////////////
 
-void Dfa_get_state_lists(Dfa *dfa_ptr, int **states, int *len_states, int *start_state, int **final_states, int *len_final_states){
-	if(states){
-		*states = dfa_ptr->states;
+static int compare_state_pairs(const void *pair1, const void *pair2){
+	int state1 = ((int *)pair1)[0];
+	int state2 = ((int *)pair2)[0];
+	return (state1 > state2) - (state1 < state2);
+}
+
+static int find_state_index(int *sorted_pairs, int len_states, int state){
+	// sorted_pairs holds (state, index) pairs sorted by state
+	int lo = 0, hi = len_states - 1;
+
+	while(lo <= hi){
+		int mid = lo + (hi - lo)/2;
+		if(sorted_pairs[2*mid] == state)	return sorted_pairs[2*mid + 1];
+		else if(sorted_pairs[2*mid] < state)	lo = mid + 1;
+		else	hi = mid - 1;
 	}
 
-	if(len_states){
-		*len_states = dfa_ptr->len_states;
+	return -1;
+}
+
+DFA_CompileResult_type Dfa_compile(Dfa *dfa_ptr){
+	if(dfa_ptr->is_view){
+		// Table is owned by the original Dfa
+		return DFA_COMPILE_RESULT_FAIL;
 	}
 
-	if(start_state){
-		*start_state = dfa_ptr->start_state;
+	int len_states = dfa_ptr->len_states;
+
+	// Map state identifiers to row indices
+
+	int *sorted_pairs = malloc( sizeof(int)*2*len_states );
+	for (int i = 0; i < len_states; ++i){
+		sorted_pairs[2*i] = dfa_ptr->states[i];
+		sorted_pairs[2*i + 1] = i;
 	}
+	qsort(sorted_pairs, len_states, sizeof(int)*2, compare_state_pairs);
 
-	if(final_states){
-		*final_states = dfa_ptr->final_states;
+	int start_index = find_state_index(sorted_pairs, len_states, dfa_ptr->start_state);
+	int index_cur = find_state_index(sorted_pairs, len_states, dfa_ptr->state_cur);
+	if(start_index < 0 || index_cur < 0){
+		free(sorted_pairs);
+		return DFA_COMPILE_RESULT_FAIL;
 	}
 
-	if(len_final_states){
-		*len_final_states = dfa_ptr->len_final_states;
+	// Build a full table of row indices. The extra last row is the dead state
+
+	int dead_index = len_states;
+	int *next_indices = malloc( sizeof(int)*256*(len_states + 1) );
+	unsigned char *final_flags = calloc(len_states + 1, sizeof(unsigned char));
+
+	for (int i = 0; i < len_states; ++i){
+		int *class_ptr = HashTable_get(dfa_ptr->state_class_table, &dfa_ptr->states[i]);
+		final_flags[i] = (*class_ptr == DFA_STATE_CLASS_FINAL);
+
+		DfaTransition *tr_head_ptr = HashTable_get(dfa_ptr->transition_table, &dfa_ptr->states[i]);
+
+		for (int c = 0; c < 256; ++c){
+			int index_next = dead_index;
+
+			// First matching transition wins, same as Dfa_step
+			for(DfaTransition *tr_ptr = tr_head_ptr; tr_ptr != NULL; tr_ptr = tr_ptr->next){
+				if( test_transition(tr_ptr, (char)c) ){
+					index_next = find_state_index(sorted_pairs, len_states, tr_ptr->to_state);
+					break;
+				}
+			}
+
+			if(index_next < 0){
+				// Transition to a state which is not in the state list
+				free(next_indices);
+				free(final_flags);
+				free(sorted_pairs);
+				return DFA_COMPILE_RESULT_FAIL;
+			}
+
+			next_indices[256*i + c] = index_next;
+		}
+	}
+
+	for (int c = 0; c < 256; ++c){
+		next_indices[256*dead_index + c] = dead_index;
+	}
+
+	DfaCompiled *cmp_ptr = DfaCompiled_new(next_indices, final_flags, len_states + 1, start_index);
+	place_table(cmp_ptr, dfa_ptr->memory_flags);
+
+	// Replace old table and sync run state
+
+	if(dfa_ptr->compiled){
+		DfaCompiled_destroy(dfa_ptr->compiled);
+	}
+	dfa_ptr->compiled = cmp_ptr;
+
+	dfa_ptr->state_index_cur = index_cur;
+	if(dfa_ptr->state_last_final_valid){
+		dfa_ptr->state_index_last_final = find_state_index(sorted_pairs, len_states, dfa_ptr->state_last_final);
 	}
+
+	free(next_indices);
+	free(final_flags);
+	free(sorted_pairs);
+
+	return DFA_COMPILE_RESULT_SUCCESS;
 }
 
-void Dfa_get_symbol_list(Dfa *dfa_ptr, char **symbols, int *len_symbols){
-	if(symbols){
-		*symbols = dfa_ptr->symbols;
+static DfaCompiled *DfaCompiled_new(int *next_indices, unsigned char *final_flags, int len_states, int start_index){
+	DfaCompiled *cmp_ptr = malloc( sizeof(DfaCompiled) );
+
+	cmp_ptr->len_states = len_states;
+	cmp_ptr->start_index = start_index;
+	cmp_ptr->dead_index = len_states - 1;
+
+	// Pick the narrowest index type which can hold every row index
+
+	if(len_states <= UINT8_MAX + 1){
+		cmp_ptr->state_width = 1;
+	}
+	else if(len_states <= UINT16_MAX + 1){
+		cmp_ptr->state_width = 2;
+	}
+	else{
+		cmp_ptr->state_width = 4;
 	}
 
-	if(len_symbols){
-		*len_symbols = dfa_ptr->len_symbols;
+	size_t len_table = (size_t)256*len_states;
+	cmp_ptr->table_bytes = len_table*cmp_ptr->state_width;
+	cmp_ptr->table = malloc(cmp_ptr->table_bytes);
+	cmp_ptr->table_mapping_bytes = 0;
+	cmp_ptr->huge_pages = DFA_HUGE_PAGES_NONE;
+	cmp_ptr->table_replicas = NULL;
+	cmp_ptr->len_table_replicas = 0;
+	cmp_ptr->cpu_nodes = NULL;
+	cmp_ptr->len_cpus = 0;
+
+	for (size_t i = 0; i < len_table; ++i){
+		if(cmp_ptr->state_width == 1)	((uint8_t *)cmp_ptr->table)[i] = next_indices[i];
+		else if(cmp_ptr->state_width == 2)	((uint16_t *)cmp_ptr->table)[i] = next_indices[i];
+		else	((uint32_t *)cmp_ptr->table)[i] = next_indices[i];
+	}
+
+	cmp_ptr->final_flags = malloc( sizeof(unsigned char)*len_states );
+	memcpy(cmp_ptr->final_flags, final_flags, len_states);
+
+	analyze_prefilter(cmp_ptr, next_indices);
+
+	cmp_ptr->jit = NULL;
+	cmp_ptr->reverse = NULL;
+
+	return cmp_ptr;
+}
+
+static void DfaCompiled_destroy(DfaCompiled *cmp_ptr){
+	if(cmp_ptr->jit){
+		DfaJit_destroy(cmp_ptr->jit);
+	}
+
+	if(cmp_ptr->reverse){
+		DfaCompiled_destroy(cmp_ptr->reverse);
+	}
+
+#if defined(__linux__)
+	if(cmp_ptr->table_replicas){
+		for (int node = 0; node < cmp_ptr->len_table_replicas; ++node){
+			if(cmp_ptr->table_replicas[node]){
+				munmap(cmp_ptr->table_replicas[node], cmp_ptr->table_mapping_bytes);
+			}
+		}
+		free(cmp_ptr->table_replicas);
+		free(cmp_ptr->cpu_nodes);
+	}
+	else if(cmp_ptr->table_mapping_bytes){
+		munmap(cmp_ptr->table, cmp_ptr->table_mapping_bytes);
+	}
+	else
+#endif
+	{
+		free(cmp_ptr->table);
+	}
+
+	free(cmp_ptr->final_flags);
+	free(cmp_ptr);
+}
+
+static unsigned int compiled_get(DfaCompiled *cmp_ptr, const void *table, unsigned int index, unsigned char symbol){
+	size_t offset = (size_t)index*256 + symbol;
+
+	if(cmp_ptr->state_width == 1)	return ((const uint8_t *)table)[offset];
+	else if(cmp_ptr->state_width == 2)	return ((const uint16_t *)table)[offset];
+	else	return ((const uint32_t *)table)[offset];
+}
+
+static void step_compiled(Dfa *dfa_ptr, int index_next, int64_t counter_next){
+	dfa_ptr->state_index_cur = index_next;
+	dfa_ptr->state_cur = dfa_ptr->states[index_next];
+	dfa_ptr->symbol_counter = counter_next;
+
+	if(dfa_ptr->compiled->final_flags[index_next]){
+		dfa_ptr->state_last_final_valid = 1;
+		dfa_ptr->state_last_final = dfa_ptr->state_cur;
+		dfa_ptr->state_index_last_final = index_next;
+		dfa_ptr->symbol_counter_last_final = counter_next;
+	}
+}
+
+// Run loop specialized for each index width. Only the last final state seen
+// is written back, so the loop body is a load, a compare and a flag test.
+#define DEFINE_RUN_COMPILED(WIDTH_BITS) \
+static size_t run_compiled_##WIDTH_BITS(Dfa *dfa_ptr, const void *table_ptr, unsigned char *input, size_t len_input){ \
+	DfaCompiled *cmp_ptr = dfa_ptr->compiled; \
+	const uint##WIDTH_BITS##_t *table = table_ptr; \
+	const unsigned char *final_flags = cmp_ptr->final_flags; \
+	const uint##WIDTH_BITS##_t dead_index = cmp_ptr->dead_index; \
+	\
+	uint##WIDTH_BITS##_t index_cur = dfa_ptr->state_index_cur; \
+	size_t len_last_final = 0;	/* Symbols consumed up to last final, 0 if none */ \
+	uint##WIDTH_BITS##_t index_last_final = 0; \
+	\
+	size_t i; \
+	for (i = 0; i < len_input; ++i){ \
+		uint##WIDTH_BITS##_t index_next = table[(size_t)index_cur*256 + input[i]]; \
+		if(index_next == dead_index)	break; \
+		index_cur = index_next; \
+		if(final_flags[index_cur]){ \
+			len_last_final = i + 1; \
+			index_last_final = index_cur; \
+		} \
+	} \
+	\
+	if(len_last_final){ \
+		dfa_ptr->state_last_final_valid = 1; \
+		dfa_ptr->state_last_final = dfa_ptr->states[index_last_final]; \
+		dfa_ptr->state_index_last_final = index_last_final; \
+		dfa_ptr->symbol_counter_last_final = dfa_ptr->symbol_counter + len_last_final; \
+	} \
+	dfa_ptr->state_index_cur = index_cur; \
+	dfa_ptr->state_cur = dfa_ptr->states[index_cur]; \
+	dfa_ptr->symbol_counter += i; \
+	\
+	return i; \
+}
+
+DEFINE_RUN_COMPILED(8)
+DEFINE_RUN_COMPILED(16)
+DEFINE_RUN_COMPILED(32)
+
+#undef DEFINE_RUN_COMPILED
+
+void Dfa_get_compiled_info(Dfa *dfa_ptr, int *compiled_ptr, int *state_width_ptr, size_t *table_bytes_ptr){
+	DfaCompiled *cmp_ptr = dfa_ptr->compiled;
+
+	if(compiled_ptr){
+		*compiled_ptr = (cmp_ptr != NULL);
+	}
+
+	if(state_width_ptr){
+		*state_width_ptr = cmp_ptr ? cmp_ptr->state_width : 0;
+	}
+
+	if(table_bytes_ptr){
+		*table_bytes_ptr = cmp_ptr ? cmp_ptr->table_bytes : 0;
+	}
+}
+
+
+//////////////////////
+// Memory placement //
+//////////////////////
+
+void Dfa_set_memory_policy(Dfa *dfa_ptr, int memory_flags){
+	dfa_ptr->memory_flags = memory_flags;
+}
+
+#if defined(__linux__)
+
+// Calls node_function for every id in a sysfs list like "0-3,8". Returns 0
+// if the file could not be read.
+static int read_sysfs_list(const char *path, void (*node_function)(int id, void *data), void *data){
+	FILE *file = fopen(path, "r");
+	if(file == NULL){
+		return 0;
+	}
+
+	int id_lo, id_hi;
+	while(fscanf(file, "%d", &id_lo) == 1){
+		id_hi = id_lo;
+
+		int c = fgetc(file);
+		if(c == '-'){
+			if(fscanf(file, "%d", &id_hi) != 1)	break;
+			c = fgetc(file);
+		}
+
+		for (int id = id_lo; id <= id_hi; ++id){
+			node_function(id, data);
+		}
+
+		if(c != ',')	break;
+	}
+
+	fclose(file);
+	return 1;
+}
+
+static void mark_node_online(int id, void *data){
+	uint64_t *nodes_online_ptr = data;
+	if(id < NUMA_LEN_NODES_MAX){
+		*nodes_online_ptr |= (uint64_t)1 << id;
+	}
+}
+
+typedef struct CpuNodeMap{
+	int *cpu_nodes;
+	int len_cpus;
+	int node;
+} CpuNodeMap;
+
+static void mark_cpu_node(int id, void *data){
+	CpuNodeMap *map_ptr = data;
+	if(id < map_ptr->len_cpus){
+		map_ptr->cpu_nodes[id] = map_ptr->node;
+	}
+}
+
+// Returns an anonymous mapping of mapping_bytes, on huge pages if
+// requested and available, bound to node unless node is negative. Returns
+// NULL if mapping or binding failed.
+static void *table_map(size_t mapping_bytes, int memory_flags, int node, DFA_HugePages_type *huge_pages_ptr){
+	void *table = MAP_FAILED;
+	*huge_pages_ptr = DFA_HUGE_PAGES_NONE;
+
+	if(memory_flags & DFA_MEMORY_HUGE_PAGES_EXPLICIT){
+		table = mmap(NULL, mapping_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if(table != MAP_FAILED){
+			*huge_pages_ptr = DFA_HUGE_PAGES_EXPLICIT;
+		}
+	}
+
+	if(table == MAP_FAILED){
+		// No reserved huge pages, fall back to transparent huge pages
+		table = mmap(NULL, mapping_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(table == MAP_FAILED){
+			return NULL;
+		}
+
+#if defined(MADV_HUGEPAGE)
+		if(memory_flags & (DFA_MEMORY_HUGE_PAGES_TRANSPARENT | DFA_MEMORY_HUGE_PAGES_EXPLICIT)){
+			if(madvise(table, mapping_bytes, MADV_HUGEPAGE) == 0){
+				*huge_pages_ptr = DFA_HUGE_PAGES_TRANSPARENT;
+			}
+		}
+#endif
+	}
+
+#if defined(SYS_mbind)
+	if(node >= 0){
+		// Bind before the first write, so pages are allocated on the node
+		unsigned long node_mask = 1UL << node;
+		if(syscall(SYS_mbind, table, mapping_bytes, NUMA_MPOL_BIND, &node_mask, sizeof(node_mask)*8 + 1, 0) != 0){
+			// Unbound copy would not be local to the node
+			munmap(table, mapping_bytes);
+			return NULL;
+		}
 	}
+#endif
+
+	return table;
+}
+
+// Copies the table into a mapping and makes the mapping read only
+static void table_fill(void *table, size_t mapping_bytes, DfaCompiled *cmp_ptr){
+	memcpy(table, cmp_ptr->table, cmp_ptr->table_bytes);
+	mprotect(table, mapping_bytes, PROT_READ);
+}
+
+// Moves the table to a single mapping. Returns 0 if the mapping failed, and
+// the table is kept from malloc.
+static int place_table_single(DfaCompiled *cmp_ptr, int memory_flags, size_t mapping_bytes){
+	DFA_HugePages_type huge_pages;
+	void *table = table_map(mapping_bytes, memory_flags, -1, &huge_pages);
+	if(table == NULL){
+		return 0;
+	}
+
+	table_fill(table, mapping_bytes, cmp_ptr);
+	free(cmp_ptr->table);
+
+	cmp_ptr->table = table;
+	cmp_ptr->table_mapping_bytes = mapping_bytes;
+	cmp_ptr->huge_pages = huge_pages;
+	return 1;
+}
+
+static void place_table(DfaCompiled *cmp_ptr, int memory_flags){
+	int huge_pages_flags = memory_flags & (DFA_MEMORY_HUGE_PAGES_TRANSPARENT | DFA_MEMORY_HUGE_PAGES_EXPLICIT);
+	int replicate = 0;
+	uint64_t nodes_online = 0;
+
+	if(memory_flags & DFA_MEMORY_NUMA_REPLICATE){
+		read_sysfs_list("/sys/devices/system/node/online", mark_node_online, &nodes_online);
+
+		// Single node machines keep one copy
+		replicate = __builtin_popcountll(nodes_online) > 1;
+	}
+
+	if(!replicate && !huge_pages_flags){
+		// Nothing to gain over malloc
+		return;
+	}
+
+	size_t page_bytes = huge_pages_flags ? HUGE_PAGE_BYTES : (size_t)sysconf(_SC_PAGESIZE);
+	size_t mapping_bytes = (cmp_ptr->table_bytes + page_bytes - 1)/page_bytes*page_bytes;
+
+	if(!replicate){
+		place_table_single(cmp_ptr, memory_flags, mapping_bytes);
+		return;
+	}
+
+	// Map CPUs to nodes, so readers can find their local replica
+
+	int len_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	CpuNodeMap map = {calloc(len_cpus, sizeof(int)), len_cpus, 0};
+
+	int len_replicas = 64 - __builtin_clzll(nodes_online);
+	void **table_replicas = calloc(len_replicas, sizeof(void *));
+	DFA_HugePages_type huge_pages = DFA_HUGE_PAGES_EXPLICIT;
+
+	for (int node = 0; node < len_replicas; ++node){
+		if( !((nodes_online >> node) & 1) ){
+			continue;
+		}
+
+		char path[64];
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+		map.node = node;
+		read_sysfs_list(path, mark_cpu_node, &map);
+
+		DFA_HugePages_type huge_pages_node;
+		table_replicas[node] = table_map(mapping_bytes, memory_flags, node, &huge_pages_node);
+		if(table_replicas[node] == NULL){
+			continue;
+		}
+
+		// Least huge page backing across replicas
+		if(huge_pages_node < huge_pages){
+			huge_pages = huge_pages_node;
+		}
+
+		table_fill(table_replicas[node], mapping_bytes, cmp_ptr);
+	}
+
+	// Primary table is the replica of the first node which got one
+	void *table = NULL;
+	for (int node = 0; node < len_replicas && table == NULL; ++node){
+		table = table_replicas[node];
+	}
+
+	if(table == NULL){
+		// No node could be bound, fall back to one unbound copy
+		free(table_replicas);
+		free(map.cpu_nodes);
+		if(huge_pages_flags){
+			place_table_single(cmp_ptr, memory_flags, mapping_bytes);
+		}
+		return;
+	}
+
+	free(cmp_ptr->table);
+
+	cmp_ptr->table = table;
+	cmp_ptr->table_mapping_bytes = mapping_bytes;
+	cmp_ptr->huge_pages = huge_pages;
+	cmp_ptr->table_replicas = table_replicas;
+	cmp_ptr->len_table_replicas = len_replicas;
+	cmp_ptr->cpu_nodes = map.cpu_nodes;
+	cmp_ptr->len_cpus = len_cpus;
+}
+
+static const void *table_local(DfaCompiled *cmp_ptr){
+	if(cmp_ptr->table_replicas){
+		int cpu = sched_getcpu();
+		if(cpu >= 0 && cpu < cmp_ptr->len_cpus){
+			void *table = cmp_ptr->table_replicas[ cmp_ptr->cpu_nodes[cpu] ];
+			if(table){
+				return table;
+			}
+		}
+	}
+
+	return cmp_ptr->table;
+}
+
+#else
+
+static void place_table(DfaCompiled *cmp_ptr, int memory_flags){
+	// Not supported, keep table from malloc
+}
+
+static const void *table_local(DfaCompiled *cmp_ptr){
+	return cmp_ptr->table;
+}
+
+#endif
+
+void Dfa_get_memory_placement(Dfa *dfa_ptr, DFA_HugePages_type *huge_pages_ptr, int *len_replicas_ptr, int *node_ptr, size_t *bytes_ptr){
+	DfaCompiled *cmp_ptr = dfa_ptr->compiled;
+
+	int len_replicas = 0;
+	int node = -1;
+
+	if(cmp_ptr && cmp_ptr->table_replicas){
+		const void *table = table_local(cmp_ptr);
+		for (int i = 0; i < cmp_ptr->len_table_replicas; ++i){
+			if(cmp_ptr->table_replicas[i]){
+				len_replicas++;
+				if(cmp_ptr->table_replicas[i] == table)	node = i;
+			}
+		}
+	}
+	else if(cmp_ptr){
+		len_replicas = 1;
+	}
+
+	if(huge_pages_ptr){
+		*huge_pages_ptr = cmp_ptr ? cmp_ptr->huge_pages : DFA_HUGE_PAGES_NONE;
+	}
+
+	if(len_replicas_ptr){
+		*len_replicas_ptr = len_replicas;
+	}
+
+	if(node_ptr){
+		*node_ptr = node;
+	}
+
+	if(bytes_ptr){
+		size_t bytes = 0;
+		if(cmp_ptr){
+			bytes = cmp_ptr->table_mapping_bytes ? cmp_ptr->table_mapping_bytes : cmp_ptr->table_bytes;
+		}
+		*bytes_ptr = bytes*len_replicas;
+	}
+}
+
+
+/////////
+// JIT //
+/////////
+
+#if defined(DFA_JIT_X86_64)
+
+typedef struct JitBuffer{
+	unsigned char *code;	// NULL to only measure
+	size_t len;
+} JitBuffer;
+
+static void emit_byte(JitBuffer *buf_ptr, unsigned char byte){
+	if(buf_ptr->code){
+		buf_ptr->code[buf_ptr->len] = byte;
+	}
+	buf_ptr->len++;
+}
+
+static void emit_bytes(JitBuffer *buf_ptr, const unsigned char *bytes, int len_bytes){
+	for (int i = 0; i < len_bytes; ++i){
+		emit_byte(buf_ptr, bytes[i]);
+	}
+}
+
+static void emit_32(JitBuffer *buf_ptr, uint32_t value){
+	for (int i = 0; i < 4; ++i){
+		emit_byte(buf_ptr, (value >> 8*i) & 0xff);
+	}
+}
+
+// Emits opcode followed by 32 bit displacement to target offset
+static void emit_jump(JitBuffer *buf_ptr, const unsigned char *opcode, int len_opcode, size_t target){
+	emit_bytes(buf_ptr, opcode, len_opcode);
+	emit_32(buf_ptr, (uint32_t)(int32_t)( (int64_t)target - (int64_t)(buf_ptr->len + 4) ));
+}
+
+// Labels of the code block of one state
+typedef struct JitLabels{
+	size_t enter;	// Consume symbol, record final state, fall into head
+	size_t head;	// Check input left, load symbol, compare and jump
+	size_t more;	// Input exhausted in this state
+	size_t trap;	// No transition on symbol in this state
+} JitLabels;
+
+// Emits the whole function. Registers: rdi input_cur, rsi input_end, rdx
+// context, eax symbol. Each state is a block; transitions are a chain of
+// compares against the upper bound of each run of symbols with the same
+// target, so the first bound not below the symbol selects the target.
+static void emit_program(JitBuffer *buf_ptr, DfaCompiled *cmp_ptr, JitLabels *labels, size_t offset_dispatch){
+	static const unsigned char op_jae[] = {0x0f, 0x83};
+	static const unsigned char op_jbe[] = {0x0f, 0x86};
+	static const unsigned char op_jmp[] = {0xe9};
+
+	int len_states = cmp_ptr->dead_index;
+
+	// Dispatch to head of start row: mov eax,[rdx]; lea rcx,[rip+table];
+	// jmp [rcx+rax*8]
+	emit_bytes(buf_ptr, (const unsigned char []){0x8b, 0x02}, 2);
+	emit_jump(buf_ptr, (const unsigned char []){0x48, 0x8d, 0x0d}, 3, offset_dispatch);
+	emit_bytes(buf_ptr, (const unsigned char []){0xff, 0x24, 0xc1}, 3);
+
+	for (int i = 0; i < len_states; ++i){
+		// inc rdi
+		labels[i].enter = buf_ptr->len;
+		emit_bytes(buf_ptr, (const unsigned char []){0x48, 0xff, 0xc7}, 3);
+		if(cmp_ptr->final_flags[i]){
+			// mov [rdx+16],rdi; mov dword [rdx+4],i
+			emit_bytes(buf_ptr, (const unsigned char []){0x48, 0x89, 0x7a, 0x10}, 4);
+			emit_bytes(buf_ptr, (const unsigned char []){0xc7, 0x42, 0x04}, 3);
+			emit_32(buf_ptr, i);
+		}
+
+		// cmp rdi,rsi; jae more; movzx eax,byte [rdi]
+		labels[i].head = buf_ptr->len;
+		emit_bytes(buf_ptr, (const unsigned char []){0x48, 0x39, 0xf7}, 3);
+		emit_jump(buf_ptr, op_jae, 2, labels[i].more);
+		emit_bytes(buf_ptr, (const unsigned char []){0x0f, 0xb6, 0x07}, 3);
+
+		int c_lo = 0;
+		while(c_lo < 256){
+			int index_next = compiled_get(cmp_ptr, cmp_ptr->table, i, c_lo);
+			int c_hi = c_lo;
+			while(c_hi + 1 < 256 && (int)compiled_get(cmp_ptr, cmp_ptr->table, i, c_hi + 1) == index_next){
+				c_hi++;
+			}
+
+			size_t target = index_next == cmp_ptr->dead_index ? labels[i].trap : labels[index_next].enter;
+			if(c_hi == 255){
+				// jmp target
+				emit_jump(buf_ptr, op_jmp, 1, target);
+			}
+			else{
+				// cmp eax,c_hi; jbe target
+				emit_byte(buf_ptr, 0x3d);
+				emit_32(buf_ptr, c_hi);
+				emit_jump(buf_ptr, op_jbe, 2, target);
+			}
+
+			c_lo = c_hi + 1;
+		}
+
+		// mov dword [rdx],i; mov [rdx+8],rdi; xor eax,eax; ret
+		labels[i].more = buf_ptr->len;
+		emit_bytes(buf_ptr, (const unsigned char []){0xc7, 0x02}, 2);
+		emit_32(buf_ptr, i);
+		emit_bytes(buf_ptr, (const unsigned char []){0x48, 0x89, 0x7a, 0x08, 0x31, 0xc0, 0xc3}, 7);
+
+		// mov dword [rdx],i; mov [rdx+8],rdi; mov eax,1; ret
+		labels[i].trap = buf_ptr->len;
+		emit_bytes(buf_ptr, (const unsigned char []){0xc7, 0x02}, 2);
+		emit_32(buf_ptr, i);
+		emit_bytes(buf_ptr, (const unsigned char []){0x48, 0x89, 0x7a, 0x08, 0xb8, 0x01, 0x00, 0x00, 0x00, 0xc3}, 10);
+	}
+}
+
+static DfaJit *DfaJit_new(DfaCompiled *cmp_ptr){
+	int len_states = cmp_ptr->dead_index;
+	JitLabels *labels = calloc(len_states, sizeof(JitLabels));
+
+	// First pass measures, and finds labels. Every jump has a 32 bit
+	// displacement, so the second pass has the same layout.
+	JitBuffer buf = {NULL, 0};
+	emit_program(&buf, cmp_ptr, labels, 0);
+
+	size_t offset_dispatch = (buf.len + 7) & ~(size_t)7;
+	size_t code_bytes = offset_dispatch + sizeof(uint64_t)*len_states;
+	if(code_bytes > JIT_CODE_BYTES_MAX){
+		free(labels);
+		return NULL;
+	}
+
+	unsigned char *code = mmap(NULL, code_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(code == MAP_FAILED){
+		free(labels);
+		return NULL;
+	}
+
+	// Second pass resolves forward jumps with labels from first pass
+	buf.code = code;
+	buf.len = 0;
+	emit_program(&buf, cmp_ptr, labels, offset_dispatch);
+
+	memset(code + buf.len, 0xcc, offset_dispatch - buf.len);
+	for (int i = 0; i < len_states; ++i){
+		uint64_t address = (uint64_t)(uintptr_t)(code + labels[i].head);
+		memcpy(code + offset_dispatch + sizeof(uint64_t)*i, &address, sizeof(uint64_t));
+	}
+
+	free(labels);
+
+	if(mprotect(code, code_bytes, PROT_READ | PROT_EXEC) != 0){
+		munmap(code, code_bytes);
+		return NULL;
+	}
+
+	DfaJit *jit_ptr = malloc( sizeof(DfaJit) );
+	jit_ptr->code = code;
+	jit_ptr->code_bytes = code_bytes;
+	jit_ptr->run_function = (DfaJit_RunFunction_type)(uintptr_t)code;
+
+	return jit_ptr;
+}
+
+static void DfaJit_destroy(DfaJit *jit_ptr){
+	munmap(jit_ptr->code, jit_ptr->code_bytes);
+	free(jit_ptr);
+}
+
+#else
+
+static void DfaJit_destroy(DfaJit *jit_ptr){
+	free(jit_ptr);
+}
+
+#endif
+
+DFA_JitResult_type Dfa_jit(Dfa *dfa_ptr){
+	if(dfa_ptr->compiled == NULL && Dfa_compile(dfa_ptr) != DFA_COMPILE_RESULT_SUCCESS){
+		return DFA_JIT_RESULT_FAIL;
+	}
+
+	if(dfa_ptr->compiled->jit){
+		return DFA_JIT_RESULT_SUCCESS;
+	}
+
+#if defined(DFA_JIT_X86_64)
+	if(dfa_ptr->is_view){
+		// Compiled table is owned by the original Dfa
+		return DFA_JIT_RESULT_FAIL;
+	}
+
+	dfa_ptr->compiled->jit = DfaJit_new(dfa_ptr->compiled);
+	if(dfa_ptr->compiled->jit == NULL){
+		return DFA_JIT_RESULT_FAIL;
+	}
+
+	return DFA_JIT_RESULT_SUCCESS;
+#else
+	return DFA_JIT_RESULT_UNSUPPORTED;
+#endif
+}
+
+static size_t run_jit(Dfa *dfa_ptr, unsigned char *input, size_t len_input){
+	DfaJitContext ctx;
+	ctx.state_index = dfa_ptr->state_index_cur;
+	ctx.input_last_final = NULL;
+
+	dfa_ptr->compiled->jit->run_function(input, input + len_input, &ctx);
+
+	if(ctx.input_last_final){
+		dfa_ptr->state_last_final_valid = 1;
+		dfa_ptr->state_index_last_final = ctx.state_index_last_final;
+		dfa_ptr->state_last_final = dfa_ptr->states[ctx.state_index_last_final];
+		dfa_ptr->symbol_counter_last_final = dfa_ptr->symbol_counter + (ctx.input_last_final - input);
+	}
+
+	size_t len_consumed = ctx.input_cur - input;
+
+	dfa_ptr->state_index_cur = ctx.state_index;
+	dfa_ptr->state_cur = dfa_ptr->states[ctx.state_index];
+	dfa_ptr->symbol_counter += len_consumed;
+
+	return len_consumed;
+}
+
+void Dfa_get_jit_info(Dfa *dfa_ptr, int *jit_ptr, size_t *code_bytes_ptr){
+	DfaJit *dfa_jit_ptr = dfa_ptr->compiled ? dfa_ptr->compiled->jit : NULL;
+
+	if(jit_ptr){
+		*jit_ptr = (dfa_jit_ptr != NULL);
+	}
+
+	if(code_bytes_ptr){
+		*code_bytes_ptr = dfa_jit_ptr ? dfa_jit_ptr->code_bytes : 0;
+	}
+}
+
+
+/////////////
+// Reverse //
+/////////////
+
+static int subset_hash_function(void *key){
+	DfaSubset *subset_ptr = key;
+
+	// FNV-1a over the words
+	uint64_t hash = 14695981039346656037ULL;
+	for (int i = 0; i < subset_ptr->len_words; ++i){
+		hash ^= subset_ptr->bits[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return (int)(hash ^ (hash >> 32)) & INT32_MAX;
+}
+
+static int subset_key_compare(void *key1, void *key2){
+	DfaSubset *subset1_ptr = key1;
+	DfaSubset *subset2_ptr = key2;
+	return memcmp(subset1_ptr->bits, subset2_ptr->bits, sizeof(uint64_t)*subset1_ptr->len_words);
+}
+
+static DfaCompiled *build_reverse(DfaCompiled *cmp_ptr){
+	int len_states = cmp_ptr->dead_index;
+	int len_words = (len_states + 63)/64;
+
+	// Reverse edges, grouped by symbol and target: preds[offsets[256*j + c]
+	// ... offsets[256*j + c + 1]] are the rows i with table[i][c] == j
+
+	int *offsets = calloc((size_t)256*len_states + 1, sizeof(int));
+	for (int i = 0; i < len_states; ++i){
+		for (int c = 0; c < 256; ++c){
+			int j = compiled_get(cmp_ptr, cmp_ptr->table, i, c);
+			if(j != cmp_ptr->dead_index)	offsets[256*j + c + 1]++;
+		}
+	}
+	for (size_t k = 0; k < (size_t)256*len_states; ++k){
+		offsets[k + 1] += offsets[k];
+	}
+
+	int *preds = malloc( sizeof(int)*((size_t)offsets[(size_t)256*len_states] + 1) );
+	int *fill = malloc( sizeof(int)*256*(size_t)len_states );
+	memcpy(fill, offsets, sizeof(int)*256*(size_t)len_states);
+	for (int i = 0; i < len_states; ++i){
+		for (int c = 0; c < 256; ++c){
+			int j = compiled_get(cmp_ptr, cmp_ptr->table, i, c);
+			if(j != cmp_ptr->dead_index)	preds[fill[256*j + c]++] = i;
+		}
+	}
+	free(fill);
+
+	// Subset construction. Reverse start is the set of final rows, and a set
+	// is final if it holds the forward start row. The empty set is the dead
+	// row, appended last.
+
+	HashTable *subset_table = HashTable_new(len_states, subset_hash_function, subset_key_compare);
+
+	int cap_subsets = 16;
+	int len_subsets = 0;
+	DfaSubset **subsets = malloc( sizeof(DfaSubset *)*cap_subsets );
+	int *next_indices = malloc( sizeof(int)*256*cap_subsets );
+
+	DfaSubset *subset_start_ptr = malloc( sizeof(DfaSubset) );
+	subset_start_ptr->index = len_subsets;
+	subset_start_ptr->len_words = len_words;
+	subset_start_ptr->bits = calloc(len_words, sizeof(uint64_t));
+	for (int i = 0; i < len_states; ++i){
+		if(cmp_ptr->final_flags[i])	subset_start_ptr->bits[i/64] |= (uint64_t)1 << (i%64);
+	}
+	subsets[len_subsets++] = subset_start_ptr;
+	HashTable_add(subset_table, subset_start_ptr, &subset_start_ptr->index);
+
+	DfaSubset subset_next;
+	subset_next.len_words = len_words;
+	subset_next.bits = malloc( sizeof(uint64_t)*len_words );
+
+	int failed = 0;
+
+	for (int k = 0; k < len_subsets && !failed; ++k){
+		for (int c = 0; c < 256; ++c){
+			memset(subset_next.bits, 0, sizeof(uint64_t)*len_words);
+			int is_empty = 1;
+
+			for (int w = 0; w < len_words; ++w){
+				uint64_t word = subsets[k]->bits[w];
+				while(word){
+					int j = 64*w + __builtin_ctzll(word);
+					word &= word - 1;
+
+					for (int p = offsets[256*j + c]; p < offsets[256*j + c + 1]; ++p){
+						subset_next.bits[preds[p]/64] |= (uint64_t)1 << (preds[p]%64);
+						is_empty = 0;
+					}
+				}
+			}
+
+			if(is_empty){
+				next_indices[256*k + c] = -1;
+				continue;
+			}
+
+			int *index_ptr = HashTable_get(subset_table, &subset_next);
+			if(index_ptr){
+				next_indices[256*k + c] = *index_ptr;
+				continue;
+			}
+
+			if(len_subsets == REVERSE_LEN_STATES_MAX){
+				failed = 1;
+				break;
+			}
+
+			if(len_subsets == cap_subsets){
+				cap_subsets *= 2;
+				subsets = realloc(subsets, sizeof(DfaSubset *)*cap_subsets);
+				next_indices = realloc(next_indices, sizeof(int)*256*cap_subsets);
+			}
+
+			DfaSubset *subset_ptr = malloc( sizeof(DfaSubset) );
+			subset_ptr->index = len_subsets;
+			subset_ptr->len_words = len_words;
+			subset_ptr->bits = malloc( sizeof(uint64_t)*len_words );
+			memcpy(subset_ptr->bits, subset_next.bits, sizeof(uint64_t)*len_words);
+			subsets[len_subsets++] = subset_ptr;
+			HashTable_add(subset_table, subset_ptr, &subset_ptr->index);
+
+			next_indices[256*k + c] = subset_ptr->index;
+		}
+	}
+
+	DfaCompiled *reverse_ptr = NULL;
+
+	if(!failed){
+		int dead_index = len_subsets;
+		next_indices = realloc(next_indices, sizeof(int)*256*(len_subsets + 1));
+		unsigned char *final_flags = malloc( sizeof(unsigned char)*(len_subsets + 1) );
+
+		for (int k = 0; k < len_subsets; ++k){
+			int start_index = cmp_ptr->start_index;
+			final_flags[k] = (subsets[k]->bits[start_index/64] >> (start_index%64)) & 1;
+
+			for (int c = 0; c < 256; ++c){
+				if(next_indices[256*k + c] < 0)	next_indices[256*k + c] = dead_index;
+			}
+		}
+
+		final_flags[dead_index] = 0;
+		for (int c = 0; c < 256; ++c){
+			next_indices[256*dead_index + c] = dead_index;
+		}
+
+		reverse_ptr = DfaCompiled_new(next_indices, final_flags, len_subsets + 1, 0);
+		free(final_flags);
+	}
+
+	// Free construction state
+
+	for (int k = 0; k < len_subsets; ++k){
+		free(subsets[k]->bits);
+		free(subsets[k]);
+	}
+	free(subsets);
+	free(subset_next.bits);
+	free(next_indices);
+	free(preds);
+	free(offsets);
+	HashTable_destroy(subset_table);
+
+	return reverse_ptr;
+}
+
+DFA_CompileResult_type Dfa_compile_reverse(Dfa *dfa_ptr){
+	if(dfa_ptr->compiled == NULL && Dfa_compile(dfa_ptr) != DFA_COMPILE_RESULT_SUCCESS){
+		return DFA_COMPILE_RESULT_FAIL;
+	}
+
+	if(dfa_ptr->compiled->reverse){
+		return DFA_COMPILE_RESULT_SUCCESS;
+	}
+
+	if(dfa_ptr->is_view){
+		// Compiled table is owned by the original Dfa
+		return DFA_COMPILE_RESULT_FAIL;
+	}
+
+	dfa_ptr->compiled->reverse = build_reverse(dfa_ptr->compiled);
+	if(dfa_ptr->compiled->reverse == NULL){
+		return DFA_COMPILE_RESULT_FAIL;
+	}
+
+	return DFA_COMPILE_RESULT_SUCCESS;
+}
+
+DFA_FindResult_type Dfa_find_start(Dfa *dfa_ptr, char *input, size_t begin, size_t end, size_t *start_ptr){
+	if(Dfa_compile_reverse(dfa_ptr) != DFA_COMPILE_RESULT_SUCCESS){
+		return DFA_FIND_RESULT_FAIL;
+	}
+
+	DfaCompiled *reverse_ptr = dfa_ptr->compiled->reverse;
+	const void *table = table_local(reverse_ptr);
+	const unsigned char *symbols = (const unsigned char *)input;
+
+	// Scan backward until the reverse Dfa traps or begin is reached,
+	// remembering the leftmost offset at which it was in a final state
+	unsigned int index_cur = reverse_ptr->start_index;
+	int found = 0;
+	size_t start = 0;
+
+	for (size_t i = end; i > begin; --i){
+		index_cur = compiled_get(reverse_ptr, table, index_cur, symbols[i - 1]);
+		if(index_cur == (unsigned int)reverse_ptr->dead_index)	break;
+		if(reverse_ptr->final_flags[index_cur]){
+			found = 1;
+			start = i - 1;
+		}
+	}
+
+	if(!found){
+		return DFA_FIND_RESULT_NOT_FOUND;
+	}
+
+	if(start_ptr){
+		*start_ptr = start;
+	}
+
+	return DFA_FIND_RESULT_FOUND;
+}
+
+
+///////////////
+// Prefilter //
+///////////////
+
+static void analyze_prefilter(DfaCompiled *cmp_ptr, int *next_indices){
+	cmp_ptr->prefilter_type = DFA_PREFILTER_NONE;
+	cmp_ptr->len_prefilter_symbols = 0;
+
+	int index_cur = cmp_ptr->start_index;
+
+	// Empty matches can start anywhere
+	if(cmp_ptr->final_flags[index_cur]){
+		return;
+	}
+
+	// Walk from start state while exactly one symbol leaves the state. Stop
+	// at a final state, since the match may end there.
+	while(cmp_ptr->len_prefilter_symbols < PREFILTER_LEN_MAX){
+		int *row = &next_indices[256*index_cur];
+		int len_out = 0;
+		int symbol_out = 0;
+
+		for (int c = 0; c < 256; ++c){
+			if(row[c] != cmp_ptr->dead_index){
+				len_out++;
+				symbol_out = c;
+			}
+		}
+
+		if(len_out != 1){
+			if(cmp_ptr->len_prefilter_symbols == 0 && len_out <= PREFILTER_LEN_BYTES_MAX){
+				// Fall back to the set of symbols leaving start state
+				for (int c = 0; c < 256; ++c){
+					if(row[c] != cmp_ptr->dead_index){
+						cmp_ptr->prefilter_symbols[cmp_ptr->len_prefilter_symbols++] = c;
+					}
+				}
+				cmp_ptr->prefilter_type = len_out ? DFA_PREFILTER_BYTES : DFA_PREFILTER_NONE;
+			}
+			return;
+		}
+
+		cmp_ptr->prefilter_symbols[cmp_ptr->len_prefilter_symbols++] = symbol_out;
+		cmp_ptr->prefilter_type = cmp_ptr->len_prefilter_symbols == 1 ? DFA_PREFILTER_BYTES : DFA_PREFILTER_LITERAL;
+
+		index_cur = row[symbol_out];
+		if(cmp_ptr->final_flags[index_cur]){
+			return;
+		}
+	}
+}
+
+// Returns offset of first symbol in input which is one of the symbols
+static size_t scan_bytes(const unsigned char *input, size_t len_input, const unsigned char *symbols, int len_symbols){
+	if(len_symbols == 1){
+		const unsigned char *found = memchr(input, symbols[0], len_input);
+		return found ? (size_t)(found - input) : len_input;
+	}
+
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	__m128i v_symbol_0 = _mm_set1_epi8(symbols[0]);
+	__m128i v_symbol_1 = _mm_set1_epi8(symbols[1]);
+	__m128i v_symbol_2 = _mm_set1_epi8(symbols[len_symbols - 1]);
+
+	for (; i + 16 <= len_input; i += 16){
+		__m128i v_input = _mm_loadu_si128((const __m128i *)(input + i));
+		__m128i v_eq = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v_input, v_symbol_0), _mm_cmpeq_epi8(v_input, v_symbol_1)),
+			_mm_cmpeq_epi8(v_input, v_symbol_2)
+		);
+
+		int mask = _mm_movemask_epi8(v_eq);
+		if(mask){
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	for (; i < len_input; ++i){
+		for (int k = 0; k < len_symbols; ++k){
+			if(input[i] == symbols[k])	return i;
+		}
+	}
+
+	return len_input;
+}
+
+// Returns offset of first occurence of literal in input. A literal cut off by
+// the end of input is reported at its start, so matches across buffer
+// boundaries are not missed.
+static size_t scan_literal(const unsigned char *input, size_t len_input, const unsigned char *literal, int len_literal){
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	// Compare first and last symbol of the literal at 16 offsets at once,
+	// and only check the middle where both match
+	__m128i v_first = _mm_set1_epi8(literal[0]);
+	__m128i v_last = _mm_set1_epi8(literal[len_literal - 1]);
+
+	for (; i + len_literal - 1 + 16 <= len_input; i += 16){
+		__m128i v_input_first = _mm_loadu_si128((const __m128i *)(input + i));
+		__m128i v_input_last = _mm_loadu_si128((const __m128i *)(input + i + len_literal - 1));
+		int mask = _mm_movemask_epi8( _mm_and_si128(
+			_mm_cmpeq_epi8(v_input_first, v_first),
+			_mm_cmpeq_epi8(v_input_last, v_last)
+		) );
+
+		while(mask){
+			int k = __builtin_ctz(mask);
+			if(memcmp(input + i + k + 1, literal + 1, len_literal - 2) == 0){
+				return i + k;
+			}
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	while(i < len_input){
+		const unsigned char *found = memchr(input + i, literal[0], len_input - i);
+		if(found == NULL){
+			return len_input;
+		}
+
+		i = found - input;
+		size_t len_cmp = len_input - i < (size_t)len_literal ? len_input - i : (size_t)len_literal;
+		if(memcmp(input + i, literal, len_cmp) == 0){
+			return i;
+		}
+		i++;
+	}
+
+	return len_input;
+}
+
+static size_t scan_prefilter(DfaCompiled *cmp_ptr, const unsigned char *input, size_t len_input){
+	if(cmp_ptr->prefilter_type == DFA_PREFILTER_BYTES){
+		return scan_bytes(input, len_input, cmp_ptr->prefilter_symbols, cmp_ptr->len_prefilter_symbols);
+	}
+	else if(cmp_ptr->prefilter_type == DFA_PREFILTER_LITERAL){
+		return scan_literal(input, len_input, cmp_ptr->prefilter_symbols, cmp_ptr->len_prefilter_symbols);
+	}
+
+	return 0;
+}
+
+static void find_first_match(int64_t start, int64_t end, void *data){
+	int64_t *match = data;
+	if(match[1] == 0){
+		match[0] = start;
+		match[1] = end;
+	}
+}
+
+DFA_FindResult_type Dfa_find(Dfa *dfa_ptr, char *input, size_t len_input, size_t *start_ptr, size_t *len_match_ptr){
+	DfaSearch *search_ptr = DfaSearch_new(dfa_ptr, DFA_SEARCH_LEFTMOST_FIRST);
+	if(search_ptr == NULL){
+		return DFA_FIND_RESULT_FAIL;
+	}
+
+	// Forward pass for the end of the leftmost match. Leftmost first ends it
+	// at its first final state, so the pass stops as early as possible.
+	int64_t match[2] = {0, 0};
+	size_t pos = 0;
+	while(pos < len_input && match[1] == 0){
+		size_t len_block = len_input - pos < FIND_LEN_BLOCK ? len_input - pos : FIND_LEN_BLOCK;
+		Dfa_search(search_ptr, input + pos, len_block, find_first_match, match);
+		pos += len_block;
+	}
+	if(match[1] == 0){
+		Dfa_search_finish(search_ptr, find_first_match, match);
+	}
+	DfaSearch_destroy(search_ptr);
+
+	if(match[1] == 0){
+		return DFA_FIND_RESULT_NOT_FOUND;
+	}
+
+	// Backward pass for the start. No match starts left of the leftmost one,
+	// so the leftmost start of a match ending here is the same start. Views
+	// without a reverse Dfa keep the start from the forward pass.
+	size_t start = match[0] - 1;
+	Dfa_find_start(dfa_ptr, input, 0, match[1], &start);
+
+	// Anchored forward run from the start for the longest end
+	DfaCompiled *cmp_ptr = dfa_ptr->compiled;
+	const void *table = table_local(cmp_ptr);
+	const unsigned char *symbols = (const unsigned char *)input;
+
+	unsigned int index_cur = cmp_ptr->start_index;
+	size_t len_match = 0;
+	for (size_t i = start; i < len_input; ++i){
+		index_cur = compiled_get(cmp_ptr, table, index_cur, symbols[i]);
+		if(index_cur == (unsigned int)cmp_ptr->dead_index)	break;
+		if(cmp_ptr->final_flags[index_cur])	len_match = i + 1 - start;
+	}
+
+	if(start_ptr){
+		*start_ptr = start;
+	}
+	if(len_match_ptr){
+		*len_match_ptr = len_match;
+	}
+
+	return DFA_FIND_RESULT_FOUND;
+}
+
+DfaSearch *DfaSearch_new(Dfa *dfa_ptr, DFA_SearchMode_type mode){
+	if(dfa_ptr->compiled == NULL && Dfa_compile(dfa_ptr) != DFA_COMPILE_RESULT_SUCCESS){
+		return NULL;
+	}
+
+	int len_states = dfa_ptr->compiled->len_states;
+
+	DfaSearch *search_ptr = malloc( sizeof(DfaSearch) );
+
+	search_ptr->dfa_ptr = dfa_ptr;
+	search_ptr->mode = mode;
+
+	// One thread per state, and one spawned before each step
+	search_ptr->threads = malloc( sizeof(DfaSearchThread)*(len_states + 1) );
+	search_ptr->threads_next = malloc( sizeof(DfaSearchThread)*(len_states + 1) );
+	search_ptr->state_marks = calloc(len_states, sizeof(uint64_t));
+
+	search_ptr->cap_matches = 16;
+	search_ptr->matches = malloc( sizeof(DfaSearchMatch)*search_ptr->cap_matches );
+
+	DfaSearch_reset(search_ptr);
+
+	return search_ptr;
+}
+
+void DfaSearch_destroy(DfaSearch *search_ptr){
+	free(search_ptr->threads);
+	free(search_ptr->threads_next);
+	free(search_ptr->state_marks);
+	free(search_ptr->matches);
+	free(search_ptr);
+}
+
+void DfaSearch_reset(DfaSearch *search_ptr){
+	search_ptr->symbol_counter = 0;
+	search_ptr->len_threads = 0;
+	search_ptr->len_matches = 0;
+	search_ptr->mark = 0;
+	memset(search_ptr->state_marks, 0, sizeof(uint64_t)*search_ptr->dfa_ptr->compiled->len_states);
+}
+
+static void search_finish_thread(DfaSearch *search_ptr, DfaSearchThread *thread_ptr){
+	if(search_ptr->len_matches == search_ptr->cap_matches){
+		search_ptr->cap_matches *= 2;
+		search_ptr->matches = realloc(search_ptr->matches, sizeof(DfaSearchMatch)*search_ptr->cap_matches);
+	}
+
+	// Younger matches overlapping this one have been dropped, but younger
+	// ones after its end may exist
+	int i = search_ptr->len_matches;
+	while(i > 0 && search_ptr->matches[i - 1].start > thread_ptr->start){
+		search_ptr->matches[i] = search_ptr->matches[i - 1];
+		i--;
+	}
+
+	search_ptr->matches[i].start = thread_ptr->start;
+	search_ptr->matches[i].end = thread_ptr->end;
+	search_ptr->matches[i].is_candidate = thread_ptr->is_candidate;
+	search_ptr->len_matches++;
+}
+
+static void search_drop_overlapping(DfaSearch *search_ptr, DfaSearchThread *thread_ptr){
+	// Finished matches which start within the match
+	int len_matches = 0;
+	for (int i = 0; i < search_ptr->len_matches; ++i){
+		DfaSearchMatch *match_ptr = &search_ptr->matches[i];
+		if(match_ptr->start > thread_ptr->start && match_ptr->start <= thread_ptr->end){
+			continue;
+		}
+		search_ptr->matches[len_matches++] = *match_ptr;
+	}
+	search_ptr->len_matches = len_matches;
+
+	// Running threads which start within the match
+	int len_threads = 0;
+	for (int i = 0; i < search_ptr->len_threads; ++i){
+		DfaSearchThread *other_ptr = &search_ptr->threads[i];
+		if(other_ptr->start > thread_ptr->start && other_ptr->start <= thread_ptr->end){
+			continue;
+		}
+		search_ptr->threads[len_threads++] = *other_ptr;
+	}
+	search_ptr->len_threads = len_threads;
+}
+
+static int search_report(DfaSearch *search_ptr, DfaSearch_MatchFunction_type match_function, void *data){
+	int len_reported = 0;
+
+	// A running thread older than a match may still produce a match which
+	// starts further left
+	int64_t start_running = search_ptr->len_threads ? search_ptr->threads[0].start : INT64_MAX;
+
+	while(len_reported < search_ptr->len_matches && search_ptr->matches[len_reported].start < start_running){
+		DfaSearchMatch *match_ptr = &search_ptr->matches[len_reported];
+		if(match_function){
+			match_function(match_ptr->start, match_ptr->end, data);
+		}
+
+		// Matches starting where no prefilter skip happened are not hits
+		if(match_ptr->is_candidate){
+			search_ptr->dfa_ptr->prefilter_hits++;
+		}
+
+		len_reported++;
+	}
+
+	if(len_reported){
+		memmove(search_ptr->matches, search_ptr->matches + len_reported, sizeof(DfaSearchMatch)*(search_ptr->len_matches - len_reported));
+		search_ptr->len_matches -= len_reported;
+	}
+
+	return len_reported;
+}
+
+int Dfa_search(DfaSearch *search_ptr, char *input, size_t len_input, DfaSearch_MatchFunction_type match_function, void *data){
+	Dfa *dfa_ptr = search_ptr->dfa_ptr;
+	DfaCompiled *cmp_ptr = dfa_ptr->compiled;
+	const void *table = table_local(cmp_ptr);
+	const unsigned char *symbols = (const unsigned char *)input;
+	int dead_index = cmp_ptr->dead_index;
+
+	int len_reported = 0;
+
+	for (size_t i = 0; i < len_input; ++i){
+		int is_candidate = 0;
+
+		// Nothing running, skip to next offset which can start a match
+		if(search_ptr->len_threads == 0 && cmp_ptr->prefilter_type != DFA_PREFILTER_NONE){
+			size_t len_skip = scan_prefilter(cmp_ptr, symbols + i, len_input - i);
+			search_ptr->symbol_counter += len_skip;
+			i += len_skip;
+			if(i == len_input){
+				break;
+			}
+			dfa_ptr->prefilter_candidates++;
+			is_candidate = 1;
+		}
+
+		int64_t counter = ++search_ptr->symbol_counter;
+
+		// Spawn a thread starting at this symbol
+		DfaSearchThread *spawn_ptr = &search_ptr->threads[search_ptr->len_threads++];
+		spawn_ptr->index = cmp_ptr->start_index;
+		spawn_ptr->start = counter;
+		spawn_ptr->end = 0;
+		spawn_ptr->is_candidate = is_candidate;
+
+		// Step all threads, oldest first
+		uint64_t mark = ++search_ptr->mark;
+		int len_threads_next = 0;
+		for (int k = 0; k < search_ptr->len_threads; ++k){
+			DfaSearchThread thread = search_ptr->threads[k];
+
+			thread.index = compiled_get(cmp_ptr, table, thread.index, symbols[i]);
+
+			if(thread.index == dead_index){
+				if(thread.end){
+					search_finish_thread(search_ptr, &thread);
+				}
+				continue;
+			}
+
+			if(search_ptr->state_marks[thread.index] == mark){
+				// Older thread already in this state. Its future is the same,
+				// so this match can not grow; if the older thread matches
+				// later, the finished match is dropped as overlapping.
+				if(thread.end){
+					search_finish_thread(search_ptr, &thread);
+				}
+				continue;
+			}
+			search_ptr->state_marks[thread.index] = mark;
+
+			if(cmp_ptr->final_flags[thread.index]){
+				thread.end = counter;
+			}
+
+			search_ptr->threads_next[len_threads_next++] = thread;
+		}
+
+		DfaSearchThread *threads_swap = search_ptr->threads;
+		search_ptr->threads = search_ptr->threads_next;
+		search_ptr->threads_next = threads_swap;
+		search_ptr->len_threads = len_threads_next;
+
+		// Resolve threads which reached a final state on this symbol, oldest
+		// first. Dropping only removes younger threads.
+		for (int k = 0; k < search_ptr->len_threads; ++k){
+			DfaSearchThread thread = search_ptr->threads[k];
+			if(thread.end != counter){
+				continue;
+			}
+
+			search_drop_overlapping(search_ptr, &thread);
+
+			if(search_ptr->mode == DFA_SEARCH_LEFTMOST_FIRST){
+				// First match is final, stop the thread
+				search_finish_thread(search_ptr, &thread);
+				memmove(&search_ptr->threads[k], &search_ptr->threads[k + 1], sizeof(DfaSearchThread)*(search_ptr->len_threads - k - 1));
+				search_ptr->len_threads--;
+				k--;
+			}
+		}
+
+		if(search_ptr->len_matches){
+			len_reported += search_report(search_ptr, match_function, data);
+		}
+	}
+
+	return len_reported;
+}
+
+int Dfa_search_finish(DfaSearch *search_ptr, DfaSearch_MatchFunction_type match_function, void *data){
+	// No more input, so every running thread with a match is finished
+	for (int k = 0; k < search_ptr->len_threads; ++k){
+		DfaSearchThread thread = search_ptr->threads[k];
+		if(thread.end){
+			search_drop_overlapping(search_ptr, &thread);
+			search_finish_thread(search_ptr, &thread);
+		}
+	}
+	search_ptr->len_threads = 0;
+
+	int len_reported = search_report(search_ptr, match_function, data);
+
+	DfaSearch_reset(search_ptr);
+
+	return len_reported;
+}
+
+void Dfa_get_prefilter_info(Dfa *dfa_ptr, DFA_Prefilter_type *prefilter_type_ptr, int *len_prefilter_ptr, uint64_t *candidates_ptr, uint64_t *hits_ptr){
+	DfaCompiled *cmp_ptr = dfa_ptr->compiled;
+
+	if(prefilter_type_ptr){
+		*prefilter_type_ptr = cmp_ptr ? cmp_ptr->prefilter_type : DFA_PREFILTER_NONE;
+	}
+
+	if(len_prefilter_ptr){
+		*len_prefilter_ptr = cmp_ptr ? cmp_ptr->len_prefilter_symbols : 0;
+	}
+
+	if(candidates_ptr){
+		*candidates_ptr = dfa_ptr->prefilter_candidates;
+	}
+
+	if(hits_ptr){
+		*hits_ptr = dfa_ptr->prefilter_hits;
+	}
+}
+
+
+///////////
+// Other //
+///////////
+
+void Dfa_get_state_lists(Dfa *dfa_ptr, int **states, int *len_states, int *start_state, int **final_states, int *len_final_states){
+	if(states){
+		*states = dfa_ptr->states;
+	}
+
+	if(len_states){
+		*len_states = dfa_ptr->len_states;
+	}
+
+	if(start_state){
+		*start_state = dfa_ptr->start_state;
+	}
+
+	if(final_states){
+		*final_states = dfa_ptr->final_states;
+	}
+
+	if(len_final_states){
+		*len_final_states = dfa_ptr->len_final_states;
+	}
+}
+
+void Dfa_get_symbol_list(Dfa *dfa_ptr, char **symbols, int *len_symbols){
+	if(symbols){
+		*symbols = dfa_ptr->symbols;
+	}
+
+	if(len_symbols){
+		*len_symbols = dfa_ptr->len_symbols;
+	}
+}
+
+static size_t compiled_bytes(DfaCompiled *cmp_ptr){
+	size_t bytes = sizeof(DfaCompiled);
+
+	int len_replicas;
+	size_t table_bytes;
+	if(cmp_ptr->table_replicas){
+		len_replicas = 0;
+		for (int i = 0; i < cmp_ptr->len_table_replicas; ++i){
+			if(cmp_ptr->table_replicas[i])	len_replicas++;
+		}
+		bytes += sizeof(void *)*cmp_ptr->len_table_replicas + sizeof(int)*cmp_ptr->len_cpus;
+	}
+	else{
+		len_replicas = 1;
+	}
+	table_bytes = cmp_ptr->table_mapping_bytes ? cmp_ptr->table_mapping_bytes : cmp_ptr->table_bytes;
+
+	bytes += table_bytes*len_replicas;
+	bytes += sizeof(unsigned char)*cmp_ptr->len_states;
+
+	if(cmp_ptr->jit){
+		bytes += sizeof(DfaJit) + cmp_ptr->jit->code_bytes;
+	}
+
+	if(cmp_ptr->reverse){
+		bytes += compiled_bytes(cmp_ptr->reverse);
+	}
+
+	return bytes;
+}
+
+void Dfa_get_stats(Dfa *dfa_ptr, DfaStats *stats_ptr){
+	memset(stats_ptr, 0, sizeof(DfaStats));
+
+	stats_ptr->len_states = dfa_ptr->len_states;
+	stats_ptr->state_chain_max = dfa_ptr->start_state;
+
+	// Walk the transition chain of every state
+
+	for (int i = 0; i < dfa_ptr->len_states; ++i){
+		int len_chain = 0;
+
+		DfaTransition *tr_ptr = HashTable_get(dfa_ptr->transition_table, &dfa_ptr->states[i]);
+		for(; tr_ptr != NULL; tr_ptr = tr_ptr->next){
+			len_chain++;
+
+			if(tr_ptr->class == TRANSITION_CLASS_SINGLE)	stats_ptr->len_transitions_single++;
+			else if(tr_ptr->class == TRANSITION_CLASS_SINGLE_INVERT)	stats_ptr->len_transitions_single_invert++;
+			else if(tr_ptr->class == TRANSITION_CLASS_MANY)	stats_ptr->len_transitions_many++;
+			else if(tr_ptr->class == TRANSITION_CLASS_MANY_INVERT)	stats_ptr->len_transitions_many_invert++;
+			else if(tr_ptr->class == TRANSITION_CLASS_RANGE)	stats_ptr->len_transitions_range++;
+			else if(tr_ptr->class == TRANSITION_CLASS_CUSTOM)	stats_ptr->len_transitions_custom++;
+			else if(tr_ptr->class == TRANSITION_CLASS_REGEX)	stats_ptr->len_transitions_regex++;
+
+			if(tr_ptr->class == TRANSITION_CLASS_MANY ||
+				tr_ptr->class == TRANSITION_CLASS_MANY_INVERT){
+				stats_ptr->symbol_bytes += sizeof(char)*tr_ptr->len_symbols;
+			}
+
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+			// glibc reports the size of the pattern buffer, but not the node
+			// and state tables it points to
+			if(tr_ptr->class == TRANSITION_CLASS_REGEX){
+				stats_ptr->regex_bytes += tr_ptr->regex.allocated;
+				if(tr_ptr->regex.fastmap){
+					stats_ptr->regex_bytes += 256;
+				}
+			}
+#endif
+		}
+
+		stats_ptr->len_transitions += len_chain;
+		if(len_chain > stats_ptr->len_chain_max){
+			stats_ptr->len_chain_max = len_chain;
+			stats_ptr->state_chain_max = dfa_ptr->states[i];
+		}
+	}
+
+	stats_ptr->transition_bytes = sizeof(DfaTransition)*stats_ptr->len_transitions;
+
+	// Estimated from the HashTable layout, which does not report its size.
+	// Both tables are created with len_states buckets. Each state class entry
+	// and each chain head is one entry holding a key, a value and a link.
+	int len_chains = 0;
+	for (int i = 0; i < dfa_ptr->len_states; ++i){
+		if(HashTable_get(dfa_ptr->transition_table, &dfa_ptr->states[i]))	len_chains++;
+	}
+	size_t bucket_bytes = sizeof(void *)*dfa_ptr->len_states;
+	size_t entry_bytes = 3*sizeof(void *);
+	stats_ptr->hash_table_bytes_estimate = 2*bucket_bytes + entry_bytes*(dfa_ptr->len_states + len_chains);
+
+	if(dfa_ptr->compiled){
+		stats_ptr->compiled_bytes = compiled_bytes(dfa_ptr->compiled);
+	}
+
+	stats_ptr->total_bytes = sizeof(Dfa)
+		+ stats_ptr->transition_bytes
+		+ stats_ptr->symbol_bytes
+		+ stats_ptr->regex_bytes
+		+ stats_ptr->hash_table_bytes_estimate
+		+ stats_ptr->compiled_bytes;
 }
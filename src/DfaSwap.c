@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "DfaSwap.h"
+
+
+
+/////////////////////
+// Data Structures //
+/////////////////////
+
+typedef struct DfaVersion DfaVersion;
+typedef struct DfaVersion {
+	DfaVersion *next;	// Next retired version
+	Dfa *dfa_ptr;
+	uint64_t version;
+} DfaVersion;
+
+typedef struct DfaSwapReader {
+	DfaSwapReader *next;
+	DfaSwap *swap_ptr;
+
+	// Version pinned between enter and exit, NULL outside. Writers do not
+	// destroy a retired version while any reader's hazard points to it.
+	_Atomic(DfaVersion *) hazard;
+
+	// View of the version last entered. Only used while that version is
+	// pinned, so its borrowed pointers may dangle in between.
+	Dfa *view_ptr;
+	uint64_t view_version;
+} DfaSwapReader;
+
+typedef struct DfaSwap{
+	_Atomic(DfaVersion *) current;
+
+	// Guards everything below. Only writers, and readers registering or
+	// unregistering, take the lock.
+	pthread_mutex_t lock;
+
+	uint64_t version_last;
+	DfaVersion *retired;
+	DfaSwapReader *readers;
+} DfaSwap;
+
+
+/////////////////////////////////
+// Private Function Prototypes //
+/////////////////////////////////
+
+static DfaVersion *DfaVersion_new(Dfa *dfa_ptr, uint64_t version);
+
+static void DfaVersion_destroy(DfaVersion *ver_ptr);
+
+// Returns 1 if any registered reader has pinned the version, else 0. Must be
+// called with the lock held.
+static int is_pinned(DfaSwap *swap_ptr, DfaVersion *ver_ptr);
+
+// Must be called with the lock held
+static int reclaim_locked(DfaSwap *swap_ptr);
+
+
+//////////////////////////////////
+// Constructors and Destructors //
+//////////////////////////////////
+
+DfaSwap *DfaSwap_new(Dfa *dfa_ptr){
+	DfaSwap *swap_ptr = malloc( sizeof(DfaSwap) );
+
+	pthread_mutex_init(&swap_ptr->lock, NULL);
+
+	swap_ptr->version_last = 1;
+	swap_ptr->retired = NULL;
+	swap_ptr->readers = NULL;
+
+	atomic_init(&swap_ptr->current, DfaVersion_new(dfa_ptr, swap_ptr->version_last));
+
+	return swap_ptr;
+}
+
+void DfaSwap_destroy(DfaSwap *swap_ptr){
+	DfaVersion_destroy( atomic_load(&swap_ptr->current) );
+
+	DfaVersion *ver_ptr = swap_ptr->retired;
+	while(ver_ptr != NULL){
+		DfaVersion *ver_ptr_next = ver_ptr->next;
+		DfaVersion_destroy(ver_ptr);
+		ver_ptr = ver_ptr_next;
+	}
+
+	pthread_mutex_destroy(&swap_ptr->lock);
+	free(swap_ptr);
+}
+
+DfaSwapReader *DfaSwapReader_new(DfaSwap *swap_ptr){
+	DfaSwapReader *reader_ptr = malloc( sizeof(DfaSwapReader) );
+
+	reader_ptr->swap_ptr = swap_ptr;
+	atomic_init(&reader_ptr->hazard, NULL);
+	reader_ptr->view_ptr = NULL;
+	reader_ptr->view_version = 0;
+
+	pthread_mutex_lock(&swap_ptr->lock);
+	reader_ptr->next = swap_ptr->readers;
+	swap_ptr->readers = reader_ptr;
+	pthread_mutex_unlock(&swap_ptr->lock);
+
+	return reader_ptr;
+}
+
+void DfaSwapReader_destroy(DfaSwapReader *reader_ptr){
+	DfaSwap *swap_ptr = reader_ptr->swap_ptr;
+
+	pthread_mutex_lock(&swap_ptr->lock);
+	DfaSwapReader **link_ptr = &swap_ptr->readers;
+	while(*link_ptr != reader_ptr){
+		link_ptr = &(*link_ptr)->next;
+	}
+	*link_ptr = reader_ptr->next;
+	pthread_mutex_unlock(&swap_ptr->lock);
+
+	if(reader_ptr->view_ptr){
+		Dfa_destroy(reader_ptr->view_ptr);
+	}
+
+	free(reader_ptr);
+}
+
+static DfaVersion *DfaVersion_new(Dfa *dfa_ptr, uint64_t version){
+	DfaVersion *ver_ptr = malloc( sizeof(DfaVersion) );
+	ver_ptr->next = NULL;
+	ver_ptr->dfa_ptr = dfa_ptr;
+	ver_ptr->version = version;
+
+	return ver_ptr;
+}
+
+static void DfaVersion_destroy(DfaVersion *ver_ptr){
+	Dfa_destroy(ver_ptr->dfa_ptr);
+	free(ver_ptr);
+}
+
+
+/////////////
+// Writers //
+/////////////
+
+uint64_t DfaSwap_publish(DfaSwap *swap_ptr, Dfa *dfa_ptr){
+	pthread_mutex_lock(&swap_ptr->lock);
+
+	uint64_t version = ++swap_ptr->version_last;
+	DfaVersion *ver_ptr_old = atomic_exchange(&swap_ptr->current, DfaVersion_new(dfa_ptr, version));
+
+	// Retire old version
+	ver_ptr_old->next = swap_ptr->retired;
+	swap_ptr->retired = ver_ptr_old;
+
+	reclaim_locked(swap_ptr);
+
+	pthread_mutex_unlock(&swap_ptr->lock);
+
+	return version;
+}
+
+int DfaSwap_reclaim(DfaSwap *swap_ptr){
+	pthread_mutex_lock(&swap_ptr->lock);
+	int len_retired = reclaim_locked(swap_ptr);
+	pthread_mutex_unlock(&swap_ptr->lock);
+
+	return len_retired;
+}
+
+static int is_pinned(DfaSwap *swap_ptr, DfaVersion *ver_ptr){
+	for(DfaSwapReader *reader_ptr = swap_ptr->readers; reader_ptr != NULL; reader_ptr = reader_ptr->next){
+		if(atomic_load(&reader_ptr->hazard) == ver_ptr){
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int reclaim_locked(DfaSwap *swap_ptr){
+	int len_retired = 0;
+
+	DfaVersion **link_ptr = &swap_ptr->retired;
+	while(*link_ptr != NULL){
+		DfaVersion *ver_ptr = *link_ptr;
+
+		if(is_pinned(swap_ptr, ver_ptr)){
+			// Check again on next reclaim
+			link_ptr = &ver_ptr->next;
+			len_retired++;
+		}
+		else{
+			*link_ptr = ver_ptr->next;
+			DfaVersion_destroy(ver_ptr);
+		}
+	}
+
+	return len_retired;
+}
+
+
+/////////////
+// Readers //
+/////////////
+
+Dfa *DfaSwapReader_enter(DfaSwapReader *reader_ptr, uint64_t *version_ptr){
+	DfaSwap *swap_ptr = reader_ptr->swap_ptr;
+
+	// Publish the hazard, then confirm the version was not retired before the
+	// hazard became visible. Once confirmed, a writer scanning the hazards
+	// after retiring it is guaranteed to see it.
+	DfaVersion *ver_ptr = atomic_load(&swap_ptr->current);
+	while(1){
+		atomic_store(&reader_ptr->hazard, ver_ptr);
+
+		DfaVersion *ver_ptr_check = atomic_load(&swap_ptr->current);
+		if(ver_ptr_check == ver_ptr){
+			break;
+		}
+		ver_ptr = ver_ptr_check;
+	}
+
+	// Versions are compared by number, as a new version may be allocated at
+	// the address of a destroyed one
+	if(reader_ptr->view_ptr == NULL || reader_ptr->view_version != ver_ptr->version){
+		if(reader_ptr->view_ptr){
+			Dfa_destroy(reader_ptr->view_ptr);
+		}
+
+		reader_ptr->view_ptr = Dfa_new_view(ver_ptr->dfa_ptr);
+		reader_ptr->view_version = ver_ptr->version;
+	}
+
+	if(version_ptr){
+		*version_ptr = ver_ptr->version;
+	}
+
+	return reader_ptr->view_ptr;
+}
+
+void DfaSwapReader_exit(DfaSwapReader *reader_ptr){
+	atomic_store_explicit(&reader_ptr->hazard, NULL, memory_order_release);
+}